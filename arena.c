@@ -0,0 +1,157 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "arena.h"
+
+/*
+ * Each region starts with a small header linking it to the previously
+ * mapped region, so that arena_destroy() and arena_free() can walk
+ * back through them. Regions are aligned to the huge page size, so
+ * that the kernel can back all of them (except perhaps the tail) with
+ * huge pages: We simply map an extra huge page worth of address space
+ * and unmap the misaligned head and tail.
+ */
+
+#define HUGEPAGE_SIZE    ((size_t)2 << 20)
+#define REGION_MIN_SIZE  HUGEPAGE_SIZE
+#define REGION_MAX_SIZE  ((size_t)1 << 30)
+
+#ifndef MPOL_DEFAULT
+#define MPOL_DEFAULT 0
+#define MPOL_BIND    2
+#endif
+#define NUMA_MAX_NODES   1024
+
+struct arena_region {
+	struct arena_region  *prev;
+	size_t               size;
+	long                 data[];
+};
+
+void
+arena_init(struct arena *a)
+{
+	a->region = NULL;
+	a->next = a->limit = NULL;
+	a->region_size = REGION_MIN_SIZE;
+	a->mapped = 0;
+	a->numa_node = -1;
+}
+
+int
+arena_set_numa_node(struct arena *a, int node)
+{
+	if (node < -1 || node >= NUMA_MAX_NODES) {
+		errno = EINVAL;
+		return -1;
+	}
+	a->numa_node = node;
+	return 0;
+}
+
+static struct arena_region *
+region_map(size_t size, int numa_node)
+{
+	size_t len = size + HUGEPAGE_SIZE;
+	uintptr_t start, aligned;
+	char *p;
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	start = (uintptr_t)p;
+	aligned = (start + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+	if (aligned > start)
+		munmap(p, aligned - start);
+	if (start + len > aligned + size)
+		munmap((char *)aligned + size, start + len - (aligned + size));
+	p = (char *)aligned;
+
+#ifdef MADV_HUGEPAGE
+	/* Merely advice; if the kernel doesn't do THP, so be it. */
+	madvise(p, size, MADV_HUGEPAGE);
+#endif
+	if (numa_node >= 0) {
+		unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(long))] = { 0 };
+
+		mask[numa_node / (8 * sizeof(long))] = 1UL << (numa_node % (8 * sizeof(long)));
+		if (syscall(SYS_mbind, p, size, MPOL_BIND, mask, NUMA_MAX_NODES, 0)) {
+			int err = errno;
+			munmap(p, size);
+			errno = err;
+			return NULL;
+		}
+	}
+	return (struct arena_region *)p;
+}
+
+void *
+arena_alloc_region(struct arena *a, size_t size)
+{
+	struct arena_region *r;
+	size_t rsize = a->region_size;
+	char *p;
+
+	/* Oversized objects get a region of their own, rounded up to whole huge pages. */
+	if (size > rsize - sizeof(*r))
+		rsize = (size + sizeof(*r) + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+
+	r = region_map(rsize, a->numa_node);
+	if (r == NULL)
+		return NULL;
+	r->prev = a->region;
+	r->size = rsize;
+	a->region = r;
+	a->mapped += rsize;
+	if (a->region_size < REGION_MAX_SIZE)
+		a->region_size *= 2;
+
+	p = (char *)r->data;
+	a->next = p + size;
+	a->limit = (char *)r + rsize;
+	return p;
+}
+
+void
+arena_free(struct arena *a, void *p)
+{
+	struct arena_region *r;
+
+	while ((r = a->region) != NULL) {
+		if ((char *)p >= (char *)r->data && (char *)p < (char *)r + r->size) {
+			a->next = p;
+			return;
+		}
+		/* p was allocated before anything in this region; drop it entirely. */
+		a->region = r->prev;
+		a->mapped -= r->size;
+		munmap(r, r->size);
+		if (a->region) {
+			a->limit = (char *)a->region + a->region->size;
+			a->next = a->limit;
+		} else {
+			a->next = a->limit = NULL;
+		}
+	}
+	/* Not found: Must have been some bogus pointer. */
+	abort();
+}
+
+void
+arena_destroy(struct arena *a)
+{
+	struct arena_region *r;
+
+	while ((r = a->region) != NULL) {
+		a->region = r->prev;
+		munmap(r, r->size);
+	}
+	a->next = a->limit = NULL;
+	a->region_size = REGION_MIN_SIZE;
+	a->mapped = 0;
+}
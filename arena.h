@@ -0,0 +1,66 @@
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+
+#include <stddef.h>
+
+/*
+ * A bump allocator for large numbers of small objects which are all
+ * freed at once. Memory is obtained directly from the kernel in large
+ * regions (starting at 2 MiB and doubling up to 1 GiB), aligned to
+ * and advised for transparent huge pages, and optionally bound to a
+ * NUMA node. Objects are aligned to 8 bytes and have no per-object
+ * overhead. Unlike obstacks, running out of memory is reported to
+ * the caller instead of aborting. Regions are mapped without
+ * MAP_NORESERVE, so they are charged against the commit limit when
+ * mapped; with vm.overcommit_memory=2 exhaustion is then reported
+ * reliably, while under the default heuristic overcommit the kernel
+ * may still defer the failure to the OOM killer.
+ */
+
+struct arena_region;
+
+struct arena {
+	struct arena_region  *region;     /* current region; each links to the previous */
+	char                 *next;       /* next free byte in the current region */
+	char                 *limit;      /* end of the current region */
+	size_t               region_size; /* size of the next region to map */
+	size_t               mapped;      /* total size of all regions */
+	int                  numa_node;   /* -1 for the default memory policy */
+};
+
+/* Initialize an empty arena; no memory is mapped until the first allocation. */
+void arena_init(struct arena *a);
+
+/* Unmap all the memory of the arena, which is left empty but usable. */
+void arena_destroy(struct arena *a);
+
+/*
+ * Bind regions mapped from now on to the given NUMA node (or, for
+ * @node == -1, go back to the default policy). Returns 0 on success,
+ * -1 with errno == EINVAL if @node is out of range.
+ */
+int arena_set_numa_node(struct arena *a, int node);
+
+/* Slow path of arena_alloc(): map a new region. */
+void *arena_alloc_region(struct arena *a, size_t size);
+
+/* Allocate @size bytes. Returns NULL (with errno set) on failure. */
+static inline void *
+arena_alloc(struct arena *a, size_t size)
+{
+	char *p = a->next;
+
+	size = (size + 7) & ~(size_t)7;
+	if (size > (size_t)(a->limit - p))
+		return arena_alloc_region(a, size);
+	a->next = p + size;
+	return p;
+}
+
+/*
+ * Free @p, which must have been returned by arena_alloc(), and
+ * everything allocated after it, like obstack_free().
+ */
+void arena_free(struct arena *a, void *p);
+
+#endif /* !ARENA_H_INCLUDED */
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "frozen.h"
+#include "bfs.h"
+
+/*
+ * The visited array doubles as the queue: Since nodes are appended
+ * in order of discovery, the nodes at distance d form a contiguous
+ * slice of it, which is the frontier for the next step (top-down), or
+ * from which the frontier bitmap is built (bottom-up). This also lets
+ * a subsequent search reset only those entries of dist which were
+ * touched.
+ *
+ * The heuristics for switching direction are those of Beamer et al.,
+ * "Direction-Optimizing Breadth-First Search": go bottom-up when the
+ * number of edges to check from the frontier exceeds 1/ALPHA of the
+ * edges incident to unvisited nodes, and go back to top-down when the
+ * frontier has shrunk to less than 1/BETA of the nodes.
+ */
+#define BFS_ALPHA 14
+#define BFS_BETA  24
+
+int
+bfs_init(struct BFS *b, const struct FrozenGraph *fg)
+{
+	size_t n = fg->node_count ? fg->node_count : 1;
+
+	memset(b, 0, sizeof(*b));
+	if (!(fg->flags & FROZEN_SYMMETRIC)) {
+		errno = EINVAL;
+		return -1;
+	}
+	b->fg = fg;
+	b->dist = malloc(n * sizeof(*b->dist));
+	b->visited = malloc(n * sizeof(*b->visited));
+	b->frontier = malloc((n + 63) / 64 * sizeof(*b->frontier));
+	if (!b->dist || !b->visited || !b->frontier) {
+		bfs_destroy(b);
+		errno = ENOMEM;
+		return -1;
+	}
+	for (uint32_t i = 0; i < fg->node_count; ++i)
+		b->dist[i] = BFS_UNREACHED;
+	return 0;
+}
+
+void
+bfs_destroy(struct BFS *b)
+{
+	free(b->dist);
+	free(b->visited);
+	free(b->frontier);
+	memset(b, 0, sizeof(*b));
+}
+
+/* Visit the unvisited neighbours of the slice visited[lo..hi) at distance d+1. */
+static uint64_t
+bfs_step_top_down(struct BFS *b, uint32_t lo, uint32_t hi, uint32_t d)
+{
+	const struct FrozenGraph *fg = b->fg;
+	uint32_t *dist = b->dist;
+	uint32_t *visited = b->visited;
+	uint32_t reached = b->reached;
+	uint64_t m_f = 0;
+
+	for (uint32_t i = lo; i < hi; ++i) {
+		uint32_t u = visited[i];
+		for (uint64_t k = fg->offset[u]; k < fg->offset[u+1]; ++k) {
+			uint32_t v = fg->adj[k];
+			if (dist[v] == BFS_UNREACHED) {
+				dist[v] = d + 1;
+				visited[reached++] = v;
+				m_f += frozen_degree(fg, v);
+			}
+		}
+	}
+	b->reached = reached;
+	return m_f;
+}
+
+/* Let each unvisited node look for a neighbour in visited[lo..hi). */
+static uint64_t
+bfs_step_bottom_up(struct BFS *b, uint32_t lo, uint32_t hi, uint32_t d)
+{
+	const struct FrozenGraph *fg = b->fg;
+	uint32_t n = fg->node_count;
+	uint32_t *dist = b->dist;
+	uint32_t *visited = b->visited;
+	uint64_t *frontier = b->frontier;
+	uint32_t reached = b->reached;
+	uint64_t m_f = 0;
+
+	memset(frontier, 0, (n + 63) / 64 * sizeof(*frontier));
+	for (uint32_t i = lo; i < hi; ++i)
+		frontier[visited[i] / 64] |= UINT64_C(1) << (visited[i] % 64);
+
+	for (uint32_t v = 0; v < n; ++v) {
+		if (dist[v] != BFS_UNREACHED)
+			continue;
+		for (uint64_t k = fg->offset[v]; k < fg->offset[v+1]; ++k) {
+			uint32_t u = fg->adj[k];
+			if (frontier[u / 64] & (UINT64_C(1) << (u % 64))) {
+				dist[v] = d + 1;
+				visited[reached++] = v;
+				m_f += frozen_degree(fg, v);
+				break;
+			}
+		}
+	}
+	b->reached = reached;
+	b->bottom_up_steps++;
+	return m_f;
+}
+
+int
+bfs_run(struct BFS *b, const uint32_t *sources, size_t count)
+{
+	const struct FrozenGraph *fg = b->fg;
+	uint32_t n = fg->node_count;
+	uint64_t m_f = 0, m_u;
+	uint32_t lo, hi, d;
+	bool bottom_up = false;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (sources[i] >= n) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	if (count == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < b->reached; ++i)
+		b->dist[b->visited[i]] = BFS_UNREACHED;
+	b->reached = 0;
+	b->bottom_up_steps = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		uint32_t s = sources[i];
+		if (b->dist[s] == BFS_UNREACHED) {
+			b->dist[s] = 0;
+			b->visited[b->reached++] = s;
+			m_f += frozen_degree(fg, s);
+		}
+	}
+	m_u = fg->adj_count - m_f;
+
+	lo = 0;
+	hi = b->reached;
+	d = 0;
+	while (lo < hi) {
+		if (!bottom_up && m_f > m_u / BFS_ALPHA)
+			bottom_up = true;
+		else if (bottom_up && hi - lo < n / BFS_BETA)
+			bottom_up = false;
+
+		if (bottom_up)
+			m_f = bfs_step_bottom_up(b, lo, hi, d);
+		else
+			m_f = bfs_step_top_down(b, lo, hi, d);
+		m_u -= m_f;
+		lo = hi;
+		hi = b->reached;
+		d++;
+	}
+	b->depth = b->dist[b->visited[b->reached - 1]];
+	return 0;
+}
+
+uint32_t
+bfs_double_sweep(struct BFS *b, uint32_t start, uint32_t *end1, uint32_t *end2)
+{
+	uint32_t far;
+
+	if (bfs_run(b, &start, 1))
+		return 0;
+	far = b->visited[b->reached - 1];
+	bfs_run(b, &far, 1);
+	if (end1)
+		*end1 = far;
+	if (end2)
+		*end2 = b->visited[b->reached - 1];
+	return b->depth;
+}
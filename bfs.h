@@ -0,0 +1,72 @@
+#ifndef BFS_H_INCLUDED
+#define BFS_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "frozen.h"
+
+/*
+ * Breadth first search over a frozen graph, which must have been
+ * created with FROZEN_SYMMETRIC (so distances are hop counts in the
+ * underlying undirected graph).
+ *
+ * The search is direction-optimizing: While the frontier is small,
+ * each step goes top-down, scanning the neighbours of the frontier
+ * for unvisited nodes. When the frontier becomes large, it switches
+ * to bottom-up steps, where each unvisited node scans its neighbours
+ * for one in the frontier (kept as a bitmap), stopping at the first
+ * hit. On graphs with small diameter this skips the vast majority of
+ * edge inspections in the few levels which contain most of the nodes.
+ *
+ * A struct BFS is a reusable workspace; consecutive searches only pay
+ * for the nodes they actually reach.
+ */
+
+#define BFS_UNREACHED UINT32_MAX
+
+struct BFS {
+	const struct FrozenGraph *fg;
+	uint32_t   *dist;      /* distance from the nearest source, or BFS_UNREACHED */
+	uint32_t   *visited;   /* the nodes reached by the last search, in order of discovery */
+	uint32_t   reached;    /* the number of entries in visited */
+	uint32_t   depth;      /* the largest finite distance */
+	uint64_t   *frontier;  /* bitmap, for bottom-up steps */
+	unsigned   bottom_up_steps;
+};
+
+/* Returns 0 on success, -1 on failure (EINVAL if @fg is not symmetric). */
+int bfs_init(struct BFS *b, const struct FrozenGraph *fg);
+void bfs_destroy(struct BFS *b);
+
+/**
+ * bfs_run - compute distances from a set of sources
+ *
+ * @sources: Frozen node numbers of the sources
+ * @count: The number of sources, at least 1
+ *
+ * On return, b->dist[i] is the distance from node i to the nearest
+ * source, and the nodes reached are b->visited[0..b->reached-1], in
+ * non-decreasing order of distance.
+ *
+ * Returns: 0 on success, -1 (with errno == EINVAL) if a source is out
+ * of range or there are none.
+ */
+int bfs_run(struct BFS *b, const uint32_t *sources, size_t count);
+
+/**
+ * bfs_double_sweep - estimate the diameter of a component
+ *
+ * @start: A node of the component; a node of high degree is a good choice.
+ * @end1, @end2: If non-NULL, receive the endpoints of the path found.
+ *
+ * Search from @start, then search again from the farthest node
+ * found. The eccentricity of that node is a lower bound for the
+ * diameter of the component, and it is exact on trees and usually
+ * very close on real-world graphs.
+ *
+ * Returns: The lower bound.
+ */
+uint32_t bfs_double_sweep(struct BFS *b, uint32_t start, uint32_t *end1, uint32_t *end2);
+
+#endif /* !BFS_H_INCLUDED */
@@ -1,242 +1,393 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <pthread.h>
 #undef NDEBUG
 #include <assert.h>
 #include <sys/queue.h>
 
 #include "graph.h"
+#include "frozen.h"
+#include "core.h"
+#include "sortedset.h"
 #include "clique.h"
 
+/*
+ * The sets P and X of the algorithm contain local node numbers of the
+ * component being processed (see struct cliqview below), in
+ * increasing order. Their memory belongs to a struct nodesetarena.
+ */
 struct NodeSet {
-	SLIST_ENTRY(NodeSet) list;
 	uint32_t len;
 	uint32_t cap;
-	bool     sorted;
-	const struct Node **nodes;
+	uint32_t *v;
+};
+
+/*
+ * The memory of the sets of the search, indexed by the depth of the
+ * frame using them (see bk_next() below). With d the degeneracy, the
+ * frame at depth k has |P| <= d - k, so there are at most d + 1
+ * frames, and the P and candidates of all of them are carved out of a
+ * single block of d(d+1) words; a d-core has at least that many
+ * adjacency entries, so this is never more than the component itself.
+ *
+ * X has no such bound: P ∪ X lies within the neighbourhood of the
+ * first node of R, so it is bounded by the maximum degree, at every
+ * depth. Reserving that for every depth could take far more than the
+ * graph, so each depth has its own X buffer, which only ever grows,
+ * to the largest X seen at that depth.
+ *
+ * Everything is reserved when a branch is started, and then the
+ * search itself never allocates (except to grow an X buffer).
+ */
+struct nodesetarena {
+	uint32_t  d;          /* the block is laid out for this degeneracy */
+	uint32_t  *pc;        /* P and candidates, by depth */
+	uint32_t  **x;        /* X, by depth; d + 1 of them */
+	uint32_t  *xcap;
+};
+
+/*
+ * A component prepared for clique enumeration: its adjacency as
+ * sorted arrays of local node numbers, built once and shared by all
+ * the recursion, and a degeneracy order. The adjacency is symmetric
+ * whatever the graph's flags: an edge stored once (GRAPH_UNDIRECTED,
+ * or plain directed) counts for both endpoints, and loops and
+ * parallel edges are dropped.
+ */
+struct cliqview {
+	struct FrozenGraph fg;
+	uint32_t           *order;  /* degeneracy order */
+	uint32_t           *rank;   /* inverse of order */
+	uint32_t           degeneracy;
+	uint32_t           first;   /* order[first...] is the (min_size-1)-core */
+	uint32_t           refs;    /* used by the parallel version */
+};
+
+/*
+ * Both the sorted-set version of the algorithm and the bitset kernel
+ * (see below) run on an explicit stack of frames, one per (would-be)
+ * recursive call, so that the search can be suspended whenever a
+ * maximal clique has been found. A frame is entered, then loops over
+ * its candidates, pushing a frame for each one and updating P and X
+ * when it returns, and is finally popped.
+ */
+enum frame_state {
+	FRAME_ENTER,
+	FRAME_LOOP,
+	FRAME_RETURN,  /* the frame for the current candidate has been popped */
+	FRAME_KERNEL,  /* handed over to the bitset kernel */
+	FRAME_DONE,
+};
+
+struct bkframe {
+	struct NodeSet     P, X, cand;
+	uint32_t           i;      /* current candidate */
+	enum frame_state   state;
+};
+
+struct bitframe {
+	uint64_t           m;      /* remaining candidates in word w */
+	uint64_t           bit;    /* current candidate */
+	uint32_t           w;
+	uint32_t           np;     /* |P| */
+	enum frame_state   state;
 };
 
-struct nodesetpool {
-	SLIST_HEAD(, NodeSet) sets;
-	uint32_t count;
+/*
+ * State of the bitset kernel (see bitkernel_start() below). The
+ * buffers are only ever grown, and are reused for every subproblem
+ * handed to the kernel.
+ */
+struct bitkernel {
+	uint32_t           k;       /* number of kernel nodes */
+	uint32_t           words;   /* words per bitset, (k+63)/64 */
+	uint32_t           *ids;    /* kernel node -> local node number */
+	uint32_t           *tmp;
+	uint64_t           *adj;    /* k rows of words words */
+	uint64_t           *stack;  /* P, X and candidates for each depth */
+	struct bitframe    *frames;
+	uint32_t           depth;
+	size_t             ids_cap, adj_cap, stack_cap, frames_cap;
 };
 
 struct cliqctx {
 	int (*user_cb)(const struct Node **, size_t, void *);
 	void *user_ctx;
-	struct NodeSet     *R;
-	struct nodesetpool pool;
+	const struct cliqview *view;
+	const struct Node  **R;
+	uint32_t           rlen;
+	struct bkframe     *frames;     /* d + 1 of them, see struct nodesetarena */
+	uint32_t           depth;
+	struct nodesetarena sets;
+	struct bitkernel   bits;
+	enum clique_pivot  pivot;
+	uint32_t           min_size;
+	struct clique_stats stats;
+	struct cliqmonitor *mon;
+	uint64_t           mon_calls, mon_cliques;  /* the part of stats added to mon */
+	uint32_t           comp_index;              /* of view, in serial runs */
 };
 
+/*
+ * Budgets and progress reports (see struct clique_options). Each
+ * context counts calls and cliques in its own stats, and adds them to
+ * the totals here whenever it checks in: every MONITOR_CALLS recursive
+ * calls, and at every top-level branch. With several threads, the
+ * totals thus lag a little, which is good enough for budgets and
+ * reports. A context finding a budget exceeded sets exhausted, and
+ * every other one stops at its next check.
+ */
+#define MONITOR_CALLS 4096
+
+struct cliqmonitor {
+	const struct clique_options *opt;
+	struct timespec    start;
+	int64_t            next_report;     /* nanoseconds since start */
+	int64_t            interval;
+	uint64_t           calls, cliques;
+	bool               exhausted;
+	bool               serial;
+	pthread_mutex_t    lock;            /* serializes reports */
+	struct clique_position pos;         /* pos.component is the number started, if !serial */
+	uint32_t           branches;
+	uint64_t           cliques_before;
+};
 
-static struct NodeSet *
-nodeset_alloc(uint32_t init)
+static int64_t
+monitor_elapsed(const struct cliqmonitor *mon)
 {
-	struct NodeSet *ns = malloc(sizeof(*ns));
-	if (!ns)
-		return NULL;
-	if (init < 7)
-		init = 7;
-	ns->nodes = malloc(init*sizeof(*ns->nodes));
-	if (!ns->nodes) {
-		free(ns);
-		return NULL;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)(now.tv_sec - mon->start.tv_sec) * 1000000000 + (now.tv_nsec - mon->start.tv_nsec);
+}
+
+static void
+monitor_report(struct cliqmonitor *mon, int64_t t, uint64_t calls, uint64_t cliques)
+{
+	const struct clique_options *opt = mon->opt;
+	struct clique_progress p = {
+		.elapsed = t / 1e9,
+		.calls = calls,
+		.cliques = cliques,
+	};
+
+	if (mon->serial) {
+		p.pos = mon->pos;
+		p.branches = mon->branches;
+		p.cliques_before = mon->cliques_before;
+	} else {
+		p.pos.component = __atomic_load_n(&mon->pos.component, __ATOMIC_RELAXED);
 	}
-	ns->len = 0;
-	ns->cap = init;
-	ns->sorted = true;
-	return ns;
+	(*opt->progress)(&p, opt->progress_ctx);
 }
 
+/* Add what cliqctx has counted since last time to the totals. */
 static void
-nodeset_free(struct NodeSet *ns)
+monitor_flush(struct cliqctx *cliqctx, uint64_t *calls, uint64_t *cliques)
 {
-	if (!ns)
-		return;
-	free(ns->nodes);
-	free(ns);
+	struct cliqmonitor *mon = cliqctx->mon;
+
+	*calls = __atomic_add_fetch(&mon->calls, cliqctx->stats.calls - cliqctx->mon_calls, __ATOMIC_RELAXED);
+	*cliques = __atomic_add_fetch(&mon->cliques, cliqctx->stats.cliques - cliqctx->mon_cliques, __ATOMIC_RELAXED);
+	cliqctx->mon_calls = cliqctx->stats.calls;
+	cliqctx->mon_cliques = cliqctx->stats.cliques;
 }
 
-static inline int
-cmp_nodeptr(const void *a, const void *b)
+/* Check in with the monitor, if any. Returns -1 if the enumeration must stop. */
+static int
+monitor_check(struct cliqctx *cliqctx)
 {
-	uintptr_t x = (uintptr_t) (*(const struct Node **) a);
-	uintptr_t y = (uintptr_t) (*(const struct Node **) b);
-	if (x < y)
+	struct cliqmonitor *mon = cliqctx->mon;
+	const struct clique_options *opt;
+	uint64_t calls, cliques;
+	int64_t t, next;
+
+	if (mon == NULL)
+		return 0;
+	opt = mon->opt;
+	monitor_flush(cliqctx, &calls, &cliques);
+	if (__atomic_load_n(&mon->exhausted, __ATOMIC_RELAXED))
+		return -1;
+
+	t = monitor_elapsed(mon);
+	if ((opt->max_seconds > 0 && t >= opt->max_seconds * 1e9) ||
+	    (opt->max_calls && calls >= opt->max_calls) ||
+	    (opt->max_cliques && cliques >= opt->max_cliques)) {
+		__atomic_store_n(&mon->exhausted, true, __ATOMIC_RELAXED);
 		return -1;
-	if (x > y)
-		return 1;
+	}
+	next = __atomic_load_n(&mon->next_report, __ATOMIC_RELAXED);
+	if (opt->progress && t >= next && pthread_mutex_trylock(&mon->lock) == 0) {
+		if (t >= mon->next_report) {
+			__atomic_store_n(&mon->next_report, t + mon->interval, __ATOMIC_RELAXED);
+			monitor_report(mon, t, calls, cliques);
+		}
+		pthread_mutex_unlock(&mon->lock);
+	}
 	return 0;
 }
-static void
-nodeset_sort(struct NodeSet *ns)
-{
-	if (ns->sorted)
-		return;
-	if (ns->len > 1)
-		qsort(ns->nodes, ns->len, sizeof(*ns->nodes), &cmp_nodeptr);
-	ns->sorted = true;
-}
 
 static void
-nodeset_clear(struct NodeSet *ns)
+monitor_init(struct cliqmonitor *mon, const struct clique_options *opt)
 {
-	ns->len = 0;
-	ns->sorted = true;
+	memset(mon, 0, sizeof(*mon));
+	mon->opt = opt;
+	mon->serial = opt->threads <= 1;
+	mon->pos = opt->resume;
+	mon->interval = opt->progress_interval > 0 ? opt->progress_interval * 1e9 : 1000000000;
+	mon->next_report = mon->interval;
+	pthread_mutex_init(&mon->lock, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &mon->start);
 }
 
 static bool
-nodeset_contains(const struct NodeSet *ns, const struct Node *node)
-{
-	if (ns->sorted && ns->len >= 7) {
-		uint32_t lower = 0, upper = ns->len, idx;
-		int cmp;
-		while (lower < upper) {
-			idx = (lower+upper)/2;
-			cmp = cmp_nodeptr(&ns->nodes[idx], &node);
-			if (cmp > 0)
-				upper = idx;
-			else if (cmp < 0)
-				lower = idx+1;
-			else
-				return true;
-		}
-		return false;
-	}
-	for (uint32_t i = 0; i < ns->len; ++i) {
-		if (ns->nodes[i] == node)
-			return true;
-	}
-	return false;  
+monitor_wanted(const struct clique_options *opt)
+{
+	return opt->max_seconds > 0 || opt->max_calls || opt->max_cliques || opt->progress;
 }
 
-static int
-nodeset_increase_capacity(struct NodeSet *ns)
+
+static inline const uint32_t *
+neighbours(const struct cliqview *view, uint32_t u, uint32_t *deg)
 {
-	uint32_t newcap = ns->cap + ns->cap/2 + 1;
-	const struct Node **new = realloc(ns->nodes, newcap*sizeof(*new));
-	if (!new)
-		return -1;
-	ns->nodes = new;
-	ns->cap = newcap;
-	return 0;
+	*deg = frozen_degree(&view->fg, u);
+	return view->fg.adj + view->fg.offset[u];
 }
 
-static int
-nodeset_append(struct NodeSet *ns, const struct Node *node)
+/* Remove x, which must be present. */
+static void
+nodeset_remove(struct NodeSet *ns, uint32_t x)
 {
-	if (ns->len == ns->cap && nodeset_increase_capacity(ns))
-		return -1;
-	/* 
-	 * The new array is properly sorted if it was either empty, or
-	 * already sorted and the node-to-be-appended compares greater than
-	 * the last element.
-	 */
-	ns->sorted = (ns->len == 0) || (ns->sorted && cmp_nodeptr(&ns->nodes[ns->len-1], &node) < 0);
-	ns->nodes[ns->len++] = node;
-	return 0;
+	size_t idx = sortedset_search(ns->v, ns->len, 0, x);
+
+	assert(idx < ns->len && ns->v[idx] == x);
+	memmove(ns->v+idx, ns->v+idx+1, (ns->len-idx-1)*sizeof(*ns->v));
+	ns->len--;
 }
-static int
-nodeset_insert_sorted(struct NodeSet *ns, const struct Node *node)
+
+/* Insert x, which must not be present; there must be room for it. */
+static void
+nodeset_insert(struct NodeSet *ns, uint32_t x)
 {
-	if (ns->len == ns->cap && nodeset_increase_capacity(ns))
-		return -1;
-	/* If the set is empty, or is not sorted, just put it at the end and then sort the whole thing. */
-	if (!ns->sorted || ns->len == 0) {
-		ns->nodes[ns->len++] = node;
-		nodeset_sort(ns);
-		return 0;
-	}
-	/* 
-	 * Here ns->len > 0. If the set is already sorted and the new
-	 * element actually belongs after the last element, we don't need to
-	 * do a binary search.
-	 */
-	if (ns->sorted && cmp_nodeptr(&ns->nodes[ns->len-1], &node) < 0) {
-		ns->nodes[ns->len++] = node;
-		return 0;
-	}
+	size_t idx;
 
-	uint32_t lower = 0, upper = ns->len, idx;
-	int cmp;
-	while (lower < upper) {
-		idx = (lower+upper)/2;
-		cmp = cmp_nodeptr(&ns->nodes[idx], &node);
-		if (cmp > 0)
-			upper = idx;
-		else if (cmp < 0)
-			lower = idx + 1;
-		else /* Shouldn't happen! Maybe just print a warning and return 0. */
-			abort();
-	}
-	/* 
-	 * If cmp < 0 at this point, this means that node should be inserted
-	 * after ns->nodes[idx]. In that case, we need to move all elements
-	 * from idx+1 and upwards one element to the right. If cmp > 0, this
-	 * means that node should be inserted before ns->nodes[idx] (that
-	 * is, at index idx), in which case all elements from idx and up
-	 * need to be moved.
-	 */
-	if (cmp < 0)
-		idx++;
-	memmove(ns->nodes+idx+1, ns->nodes+idx, (ns->len-idx)*sizeof(*ns->nodes));
-	ns->nodes[idx] = node;
+	assert(ns->len < ns->cap);
+	/* We mostly add elements in order, so check the end first. */
+	if (ns->len == 0 || ns->v[ns->len-1] < x) {
+		ns->v[ns->len++] = x;
+		return;
+	}
+	idx = sortedset_search(ns->v, ns->len, 0, x);
+	assert(ns->v[idx] != x);
+	memmove(ns->v+idx+1, ns->v+idx, (ns->len-idx)*sizeof(*ns->v));
+	ns->v[idx] = x;
 	ns->len++;
-	return 0;
 }
+
 static void
-nodeset_intersect(struct NodeSet *A, const struct NodeSet *B)
+nsa_destroy(struct nodesetarena *nsa)
 {
-	uint32_t target = 0;
-	for (uint32_t source = 0; source < A->len; ++source) {
-		if (nodeset_contains(B, A->nodes[source]))
-			A->nodes[target++] = A->nodes[source];
+	if (nsa->x) {
+		for (uint32_t k = 0; k <= nsa->d; ++k)
+			free(nsa->x[k]);
 	}
-	A->len = target;
+	free(nsa->x);
+	free(nsa->xcap);
+	free(nsa->pc);
+	memset(nsa, 0, sizeof(*nsa));
 }
 
-
-static void
-nsp_init(struct nodesetpool *pool)
+/*
+ * Lay out the arena (and the frames, and R) for degeneracy d. A
+ * layout for a larger d serves as well, so this only reallocates
+ * when d grows.
+ */
+static int
+nsa_reserve(struct cliqctx *cliqctx, uint32_t d)
 {
-	pool->count = 0;
-	SLIST_INIT(&pool->sets);
+	struct nodesetarena *nsa = &cliqctx->sets, new = { .d = d };
+	struct bkframe *frames;
+	const struct Node **R;
+
+	if (nsa->x && d <= nsa->d)
+		return 0;
+	new.pc = malloc(((size_t)d * (d + 1) + 1) * sizeof(*new.pc));
+	new.x = calloc((size_t)d + 1, sizeof(*new.x));
+	new.xcap = calloc((size_t)d + 1, sizeof(*new.xcap));
+	frames = realloc(cliqctx->frames, ((size_t)d + 1) * sizeof(*frames));
+	if (frames)
+		cliqctx->frames = frames;
+	/* A clique has at most d + 1 nodes. */
+	R = realloc(cliqctx->R, ((size_t)d + 1) * sizeof(*R));
+	if (R)
+		cliqctx->R = R;
+	if (!new.pc || !new.x || !new.xcap || !frames || !R) {
+		free(new.pc);
+		free(new.x);
+		free(new.xcap);
+		return -1;
+	}
+	/* Keep the X buffers grown so far. */
+	if (nsa->x) {
+		memcpy(new.x, nsa->x, ((size_t)nsa->d + 1) * sizeof(*new.x));
+		memcpy(new.xcap, nsa->xcap, ((size_t)nsa->d + 1) * sizeof(*new.xcap));
+		free(nsa->x);
+		free(nsa->xcap);
+		free(nsa->pc);
+	}
+	*nsa = new;
+	return 0;
 }
+
+/* Point the P and the candidates of the frame at depth k at their space. */
 static void
-nsp_destroy(struct nodesetpool *pool)
+nsa_frame(struct nodesetarena *nsa, struct bkframe *f, uint32_t k)
 {
-	struct NodeSet *ns;
+	/* Depth j has 2(d - j) words, so depth k starts after 2(kd - k(k-1)/2). */
+	uint32_t *base = nsa->pc + 2 * ((size_t)k * nsa->d - (size_t)k * (k - 1) / 2);
 
-	while ((ns = SLIST_FIRST(&pool->sets)) != NULL) {
-		SLIST_REMOVE_HEAD(&pool->sets, list);
-		nodeset_free(ns);
-	}
-	pool->count = 0;
+	f->P.v = base;
+	f->P.cap = nsa->d - k;
+	f->P.len = 0;
+	f->cand.v = base + f->P.cap;
+	f->cand.cap = f->P.cap;
+	f->cand.len = 0;
 }
-static struct NodeSet*
-nsp_get(struct nodesetpool *pool, uint32_t cap)
+
+/* Point the X of the frame at depth k at a buffer with room for cap nodes. */
+static int
+nsa_frame_x(struct nodesetarena *nsa, struct bkframe *f, uint32_t k, uint32_t cap)
 {
-	struct NodeSet *ns;
+	if (cap == 0)
+		cap = 1;
+	if (cap > nsa->xcap[k]) {
+		uint32_t *x;
 
-	ns = SLIST_FIRST(&pool->sets);
-	if (ns) {
-		SLIST_REMOVE_HEAD(&pool->sets, list);
-		pool->count--;
-		return ns;
+		if (cap < 2 * nsa->xcap[k])
+			cap = 2 * nsa->xcap[k];
+		x = realloc(nsa->x[k], cap * sizeof(*x));
+		if (!x)
+			return -1;
+		nsa->x[k] = x;
+		nsa->xcap[k] = cap;
 	}
-	return nodeset_alloc(cap);
+	f->X.v = nsa->x[k];
+	f->X.cap = nsa->xcap[k];
+	f->X.len = 0;
+	return 0;
 }
 
-static void
-nsp_put(struct nodesetpool *pool, struct NodeSet *ns)
+static inline int
+report_clique(struct cliqctx *cliqctx)
 {
-	if (!ns)
-		return;
-	SLIST_INSERT_HEAD(&pool->sets, ns, list);
-	pool->count++;
+	return (*cliqctx->user_cb)(cliqctx->R, cliqctx->rlen, cliqctx->user_ctx);
 }
 
 
@@ -269,231 +420,1548 @@ nsp_put(struct nodesetpool *pool, struct NodeSet *ns)
  *
  * Since this is C, we have to handle the memory management and set
  * manipulation ourselves. First note that the set R can be shared
- * between all the recursive calls to BK - it is simply a stack. For
- * simplicity, we choose to represent a set of nodes using a standard
- * managed array (keep track of the current length and capacity). Since
- * we will need to do some set manipulations, we add the option to sort
- * the array canonically (we simpy sort the array by pointer value),
- * facilitating fast lookup. Each recursive call will need to pass a
- * new copy of P and X. Instead of allocating and freeing in each step,
- * we get and put from a pool of nodesets.
+ * between all the recursive calls to BK - it is simply a stack. Its
+ * size is bounded by the degeneracy of the component plus one, so it
+ * is allocated up front.
+ *
+ * The nodes of the component are numbered locally, and its adjacency
+ * lists are built once as sorted arrays of local numbers (struct
+ * cliqview). P and X are sorted arrays as well, so P ⋂ N(v), X ⋂ N(v)
+ * and P \ N(u) are intersections or differences of sorted arrays,
+ * done by merging or galloping (see sortedset.h). Each recursive call
+ * will need to pass a new copy of P and X, which are written straight
+ * into the space for the next depth (struct nodesetarena).
+ *
+ * The candidates P \ N(u) are computed before the loop; in it, v is
+ * removed from P and inserted into X. Both are a memmove, which costs
+ * no more than the intersections.
+ *
+ * The recursion is unrolled onto an explicit stack (struct bkframe),
+ * so bk_next() can return each maximal clique as it is found, and
+ * resume the search on the following call. Nothing but the frames
+ * lives between calls, so this costs no more than recursing.
  *
- * We will ensure that P and X are sorted on every call to BK. This
- * makes the set manipulations faster. Appending to X in the loop is
- * easy. Removing from P is a lot harder. In the non-pivoting version,
- * we can simply solve this by cheating: When v = P[i] and we need to
- * form P ⋂ N(v), we just iterate from j=i+1. However, this implicit
- * removal breaks down in the pivoting case: If we just do a naive "if
- * (v and the pivot are neighbours) continue;", we would implicitly
- * have removed v from P on subsequent iterations, even though the
- * algorithm would never have reached the "P := P \ {v}" line. We
- * repair this by adding v to a list of exceptions, which we remember
- * to include in newP.
+ * With a minimum clique size k (struct clique_options), a branch
+ * cannot produce anything once |R| + |P| < k, so it is cut right
+ * away; and the loop over the candidates stops as soon as moving them
+ * from P to X makes that true.
  *
  * Compiling with USE_PIVOT = 0 or 1 should produce identical results.
  */
 
-#define USE_PIVOT 1
+/*
+ * Once P and X are small, the remaining recursion is better done on
+ * bitsets: Number the nodes of P ∪ X locally (P first), and build an
+ * adjacency matrix with one bitset row per local node. Then P ∩ N(v)
+ * and X ∩ N(v) are word-wise ANDs, and we can afford the pivot of
+ * Tomita et al., which maximizes |P ∩ N(u)|, since each candidate
+ * costs a few popcounts.
+ *
+ * Only the rows of the nodes in P need their X columns; the rows of
+ * the nodes in X are only used for choosing the pivot, and the nodes
+ * we branch on (and hence intersect with) always come from P. So we
+ * only intersect the neighbours of the nodes in P with P and X, and
+ * fill in the P columns of the X rows by symmetry.
+ *
+ * The kernel is used when |P| >= BITSET_MIN_P, since for smaller P the
+ * set-up costs more than the recursion it replaces, and |P ∪ X| <=
+ * BITSET_MAX_NODES, which bounds the matrix at 2 MiB. Like the main
+ * algorithm, it runs on an explicit stack, in bitkernel_next().
+ */
+#define BITSET_MIN_P      4
+#define BITSET_MAX_NODES  4096
+
 static int
-BronKerbosch(struct cliqctx *cliqctx, struct NodeSet *P, struct NodeSet *X)
+bitkernel_reserve(uint64_t **buf, size_t *cap, size_t need)
 {
-	struct NodeSet *newP = NULL, *newX = NULL;
-	const struct Node *v;
-#if USE_PIVOT
-	const struct Node *pivot;
-	struct NodeSet *still_in_P = NULL;
-#endif
-	struct Edge *edge;
-	int ret = -1;
+	uint64_t *new;
 
-	if (P->len == 0) {
-		if (X->len == 0)
-			return (*cliqctx->user_cb)(cliqctx->R->nodes, cliqctx->R->len, cliqctx->user_ctx);
+	if (need <= *cap)
 		return 0;
-	}
-
-	/* 
-	 * The R we pass into the recursive call will have cardinality
-	 * precisely |R|+1. The other two are bounded by |P| and |X|, but
-	 * probably in practice a lot smaller.
-	 */
-	if (cliqctx->R->len == cliqctx->R->cap && nodeset_increase_capacity(cliqctx->R))
+	if (need < 2 * *cap)
+		need = 2 * *cap;
+	new = realloc(*buf, need * sizeof(*new));
+	if (!new)
 		return -1;
+	*buf = new;
+	*cap = need;
+	return 0;
+}
 
-	newP = nsp_get(&cliqctx->pool, 0);
-	newX = nsp_get(&cliqctx->pool, 0);
-	if (newP == NULL || newX == NULL)
-		goto out;
-  
-#if USE_PIVOT
-	/* Choose the node among P \union X with the largest number of neighbours. */
-	pivot = P->nodes[0];
-	for (uint32_t i = 1; i < P->len; ++i) {
-		if (P->nodes[i]->out_degree > pivot->out_degree)
-			pivot = P->nodes[i];
-	}
-	for (uint32_t i = 0; i < X->len; ++i) {
-		if (X->nodes[i]->out_degree > pivot->out_degree)
-			pivot = X->nodes[i];
-	}
-	/* We will add at most all elements of P, and at most all neighbours of pivot, to still_in_P. */
-	still_in_P = nsp_get(&cliqctx->pool, pivot->out_degree < P->len ? pivot->out_degree : P->len);
-	if (still_in_P == NULL)
-		goto out;
-	nodeset_clear(still_in_P);
-#endif  
+static void
+bitkernel_destroy(struct bitkernel *bk)
+{
+	free(bk->ids);
+	free(bk->tmp);
+	free(bk->adj);
+	free(bk->stack);
+	free(bk->frames);
+	memset(bk, 0, sizeof(*bk));
+}
 
-	for (uint32_t i = 0; i < P->len; ++i) {
-		v = P->nodes[i];
-#if USE_PIVOT
-		if (graph_edge_exists(pivot, v)) {
-			/* Remember that v actually belongs to P. */
-			if (nodeset_insert_sorted(still_in_P, v)) {
-				ret = -1;
-				goto out;
+/*
+ * Run the kernel until it finds a maximal clique (returning 1, with
+ * the clique in R) or is done (returning 0). Returns -1 on allocation
+ * failure, or if the monitor says stop.
+ */
+static int
+bitkernel_next(struct cliqctx *cliqctx)
+{
+	struct bitkernel *bk = &cliqctx->bits;
+	size_t W = bk->words;
+
+	while (bk->depth > 0) {
+		uint32_t d = bk->depth - 1;
+		struct bitframe *bf = &bk->frames[d];
+		uint64_t *P = bk->stack + 3*d*W, *X = P + W, *cand = X + W;
+		uint64_t *nP, *nX;
+		const uint64_t *row;
+		uint32_t pivot = UINT32_MAX, best = 0, v;
+		bool xempty = true;
+
+		switch (bf->state) {
+		case FRAME_ENTER:
+			if (++cliqctx->stats.calls % MONITOR_CALLS == 0 && monitor_check(cliqctx))
+				return -1;
+			bf->np = 0;
+			for (size_t w = 0; w < W; ++w) {
+				bf->np += __builtin_popcountll(P[w]);
+				xempty = xempty && !X[w];
 			}
-			continue;
-		}
-#endif
+			if (cliqctx->rlen + bf->np < cliqctx->min_size) {
+				bf->state = FRAME_DONE;
+				break;
+			}
+			if (bf->np == 0) {
+				bf->state = FRAME_DONE;
+				if (xempty) {
+					cliqctx->stats.cliques++;
+					return 1;
+				}
+				break;
+			}
+			if (bitkernel_reserve(&bk->stack, &bk->stack_cap, 3*(d+2)*W))
+				return -1;
+			P = bk->stack + 3*d*W;
+			X = P + W;
+			cand = X + W;
+			for (size_t w = 0; w < W; ++w) {
+				uint64_t m = P[w] | X[w];
+				while (m) {
+					uint32_t u = 64*w + __builtin_ctzll(m);
+					uint32_t c = 0;
+					m &= m - 1;
+					if (cliqctx->pivot == CLIQUE_PIVOT_DEGREE) {
+						c = frozen_degree(&cliqctx->view->fg, bk->ids[u]);
+					} else {
+						row = bk->adj + u*W;
+						for (size_t i = 0; i < W; ++i)
+							c += __builtin_popcountll(P[i] & row[i]);
+					}
+					if (pivot == UINT32_MAX || c > best) {
+						pivot = u;
+						best = c;
+					}
+				}
+			}
+			row = bk->adj + pivot*W;
+			for (size_t w = 0; w < W; ++w)
+				cand[w] = P[w] & ~row[w];
+			bf->w = 0;
+			bf->m = cand[0];
+			bf->state = FRAME_LOOP;
+			break;
 
-		/* 
-		 * Prepare R, newP and newX. There must be room in R. When
-		 * creating newP = P\intersect N(v), we should think of P as
-		 * consisting of the nodes from index i and onwards together with
-		 * still_in_P.
-		 */
-		assert(nodeset_append(cliqctx->R, v) == 0);
-		nodeset_clear(newP);
-		nodeset_clear(newX);
-		/* We use newX temporarily to contain N(v) */
-		SLIST_FOREACH(edge, &v->out_edges, nodelink) {
-			if (nodeset_insert_sorted(newX, edge->tgt)) {
-				ret = -1;
-				goto out;
+		case FRAME_LOOP:
+			while (bf->m == 0 && bf->w + 1 < W)
+				bf->m = cand[++bf->w];
+			if (bf->m == 0 || cliqctx->rlen + bf->np < cliqctx->min_size) {
+				bf->state = FRAME_DONE;
+				break;
 			}
-		}
+			v = 64*bf->w + __builtin_ctzll(bf->m);
+			bf->bit = bf->m & -bf->m;
+			bf->m &= bf->m - 1;
+			bf->state = FRAME_RETURN;
 
-		/* 
-		 * Create P\intersect N(v) by first iterating over still_in_P,
-		 * then iterating over P from j=i+1, and for each one asking if
-		 * the node is an element of N(v).
-		 *
-		 * Note that still_in_P is a subsequence of P, so doing it this
-		 * way should ensure that we create newP in a sorted manner, so
-		 * that nodeset_insert_sorted() calls are O(1).
-		 */
-#if USE_PIVOT
-		for (uint32_t j = 0; j < still_in_P->len; ++j) {
-			if (nodeset_contains(newX, still_in_P->nodes[j])) {
-				if (nodeset_insert_sorted(newP, still_in_P->nodes[j])) {
-					ret = -1;
-					goto out;
-				}
+			if (bk->depth == bk->frames_cap) {
+				size_t cap = bk->frames_cap ? 2*bk->frames_cap : 16;
+				struct bitframe *new = realloc(bk->frames, cap * sizeof(*new));
+				if (!new)
+					return -1;
+				bk->frames = new;
+				bk->frames_cap = cap;
 			}
+			nP = P + 3*W;
+			nX = nP + W;
+			row = bk->adj + v*W;
+			for (size_t i = 0; i < W; ++i) {
+				nP[i] = P[i] & row[i];
+				nX[i] = X[i] & row[i];
+			}
+			cliqctx->R[cliqctx->rlen++] = cliqctx->view->fg.nodes[bk->ids[v]];
+			bk->frames[bk->depth++].state = FRAME_ENTER;
+			break;
+
+		case FRAME_RETURN:
+			P[bf->w] &= ~bf->bit;
+			X[bf->w] |= bf->bit;
+			bf->np--;
+			bf->state = FRAME_LOOP;
+			break;
+
+		default:
+			/* Every frame but the first has added a node to R. */
+			if (--bk->depth > 0)
+				cliqctx->rlen--;
+			break;
 		}
-#endif
-		for (uint32_t j = i+1; j < P->len; ++j) {
-			if (nodeset_contains(newX, P->nodes[j])) {
-				if (nodeset_insert_sorted(newP, P->nodes[j])) {
-					ret = -1;
-					goto out;
-				}
+	}
+	return 0;
+}
+
+/*
+ * For each element of the sorted array s which is also in the sorted
+ * array nb, set the bit (off + its position in s) in row. tmp must
+ * have room for min(ns, nn) elements.
+ */
+static void
+bitkernel_mark(uint64_t *row, uint32_t off, const uint32_t *s, uint32_t ns,
+	       const uint32_t *nb, uint32_t nn, uint32_t *tmp)
+{
+	size_t c = sortedset_intersect(s, ns, nb, nn, tmp);
+	size_t j = 0;
+
+	for (size_t i = 0; i < c; ++i) {
+		uint32_t pos;
+		j = sortedset_search(s, ns, j, tmp[i]);
+		pos = off + j;
+		row[pos/64] |= 1ULL << (pos % 64);
+	}
+}
+
+/* Hand the subproblem (P, X) to the kernel; bitkernel_next() does the work. */
+static int
+bitkernel_start(struct cliqctx *cliqctx, const struct NodeSet *P, const struct NodeSet *X)
+{
+	const struct cliqview *view = cliqctx->view;
+	struct bitkernel *bk = &cliqctx->bits;
+	uint32_t np = P->len;
+	size_t W;
+
+	bk->k = P->len + X->len;
+	bk->words = W = (bk->k + 63) / 64;
+	if (bk->k > bk->ids_cap) {
+		uint32_t *ids = realloc(bk->ids, bk->k * sizeof(*ids));
+		uint32_t *tmp = ids ? realloc(bk->tmp, bk->k * sizeof(*tmp)) : NULL;
+		if (ids)
+			bk->ids = ids;
+		if (tmp)
+			bk->tmp = tmp;
+		if (!ids || !tmp)
+			return -1;
+		bk->ids_cap = bk->k;
+	}
+	if (bitkernel_reserve(&bk->adj, &bk->adj_cap, bk->k*W) ||
+	    bitkernel_reserve(&bk->stack, &bk->stack_cap, 3*W))
+		return -1;
+	if (bk->frames_cap == 0) {
+		bk->frames = malloc(16 * sizeof(*bk->frames));
+		if (!bk->frames)
+			return -1;
+		bk->frames_cap = 16;
+	}
+
+	memcpy(bk->ids, P->v, np * sizeof(*bk->ids));
+	memcpy(bk->ids + np, X->v, X->len * sizeof(*bk->ids));
+	memset(bk->adj, 0, bk->k*W * sizeof(*bk->adj));
+	for (uint32_t i = 0; i < np; ++i) {
+		uint64_t *row = bk->adj + i*W;
+		uint32_t d;
+		const uint32_t *nv = neighbours(view, P->v[i], &d);
+
+		bitkernel_mark(row, 0, P->v, P->len, nv, d, bk->tmp);
+		bitkernel_mark(row, np, X->v, X->len, nv, d, bk->tmp);
+		/* The P columns of the X rows, by symmetry. */
+		for (uint32_t j = np/64; j < W; ++j) {
+			uint64_t m = row[j];
+			if (j == np/64)
+				m &= ~0ULL << (np % 64);
+			while (m) {
+				uint32_t x = 64*j + __builtin_ctzll(m);
+				m &= m - 1;
+				bk->adj[x*W + i/64] |= 1ULL << (i % 64);
 			}
 		}
-		/* Now restrict newX to its intersection with X. */
-		nodeset_intersect(newX, X);
+	}
 
-		/* Now newP := P \intersect N(v) and newX := X \intersect N(v). */
-		ret = BronKerbosch(cliqctx, newP, newX);
-		if (ret)
-			goto out;
+	memset(bk->stack, 0, 3*W * sizeof(*bk->stack));
+	for (uint32_t i = 0; i < bk->k; ++i)
+		bk->stack[(i < np ? 0 : W) + i/64] |= 1ULL << (i % 64);
+	bk->frames[0].state = FRAME_ENTER;
+	bk->depth = 1;
+	return 0;
+}
 
-		/* Remove v from R again. */
-		cliqctx->R->len--;
+/*
+ * Choose the pivot u among P ∪ X. Tomita, Tanaka and Takahashi showed
+ * that maximizing |P ∩ N(u)|, which minimizes the number of branches
+ * P \ N(u), bounds the running time by O(3^(n/3)), the maximal number
+ * of maximal cliques. Each |P ∩ N(u)| is a sorted intersection, which
+ * gallops when u has many more neighbours than P has nodes. The old
+ * rule, the node with the largest degree, costs nothing to compute
+ * but ignores P entirely.
+ */
+static uint32_t
+choose_pivot(struct cliqctx *cliqctx, const struct NodeSet *P, const struct NodeSet *X)
+{
+	const struct cliqview *view = cliqctx->view;
+	uint32_t pivot = P->v[0];
+	uint64_t best = 0;
 
-		/* Removing v from P is implicit. */
+	for (uint32_t i = 0; i < P->len + X->len; ++i) {
+		uint32_t u = i < P->len ? P->v[i] : X->v[i - P->len];
+		uint32_t d;
+		const uint32_t *nu = neighbours(view, u, &d);
+		uint64_t c;
 
-		/* 
-		 * Add v to X. If P is sorted, we will be adding elements to X in
-		 * order, so this should actually be O(1).
-		 */
-		if (nodeset_insert_sorted(X, v)) {
-			ret = -1;
-			goto out;
+		if (cliqctx->pivot == CLIQUE_PIVOT_DEGREE)
+			c = d;
+		else
+			c = sortedset_intersect_count(P->v, P->len, nu, d);
+		if (i == 0 || c > best) {
+			pivot = u;
+			best = c;
 		}
 	}
-	ret = 0;
+	return pivot;
+}
 
-out:
-	/* 
-	 * Put in the opposite order of get, so that we use the pool as a
-	 * stack. On subsequent recursive calls, we will then get a newP
-	 * which also previously played the role of newP (similarly for newX
-	 * and still_in_P), which should greatly increase the chance that
-	 * they already have appropriate capacity.
-	 */
+/*
+ * Set up the frame at the next depth, with room for a P of at most
+ * |P| nodes and an X of at most |P| + |X| nodes of the current frame
+ * (the child's P ∪ X is within the parent's); the caller fills them
+ * in, and then pushes it by incrementing depth.
+ */
+static struct bkframe *
+bk_child(struct cliqctx *cliqctx, const struct bkframe *f)
+{
+	uint32_t k = cliqctx->depth;
+	struct bkframe *g = &cliqctx->frames[k];
+
+	assert(k <= cliqctx->sets.d);
+	if (nsa_frame_x(&cliqctx->sets, g, k, f->P.len + f->X.len))
+		return NULL;
+	nsa_frame(&cliqctx->sets, g, k);
+	g->i = 0;
+	g->state = FRAME_ENTER;
+	return g;
+}
+
+static void
+bk_pop(struct cliqctx *cliqctx)
+{
+	cliqctx->depth--;
+	cliqctx->rlen--;
+}
+
+/* Abandon the search, e.g. after an error or when the consumer stops early. */
+static void
+bk_abort(struct cliqctx *cliqctx)
+{
+	cliqctx->bits.depth = 0;
+	cliqctx->depth = 0;
+	cliqctx->rlen = 0;
+}
+
+#define USE_PIVOT 1
+/*
+ * Run the search until it finds a maximal clique (returning 1, with
+ * the clique in R) or is done (returning 0). Returns -1 on
+ * allocation failure, or if the monitor says stop, in which case the
+ * caller must bk_abort().
+ */
+static int
+bk_next(struct cliqctx *cliqctx)
+{
+	const struct cliqview *view = cliqctx->view;
+
+	while (cliqctx->depth > 0) {
+		struct bkframe *f = &cliqctx->frames[cliqctx->depth-1], *g;
+		const uint32_t *nv;
+		uint32_t d, v;
+		int ret;
+
+		switch (f->state) {
+		case FRAME_ENTER:
+			if (++cliqctx->stats.calls % MONITOR_CALLS == 0 && monitor_check(cliqctx))
+				return -1;
+			if (cliqctx->rlen + f->P.len < cliqctx->min_size) {
+				f->state = FRAME_DONE;
+				break;
+			}
+			if (f->P.len == 0) {
+				f->state = FRAME_DONE;
+				if (f->X.len == 0) {
+					cliqctx->stats.cliques++;
+					return 1;
+				}
+				break;
+			}
+			if (f->P.len >= BITSET_MIN_P && f->P.len + f->X.len <= BITSET_MAX_NODES) {
+				if (bitkernel_start(cliqctx, &f->P, &f->X))
+					return -1;
+				f->state = FRAME_KERNEL;
+				break;
+			}
 #if USE_PIVOT
-	nsp_put(&cliqctx->pool, still_in_P);
+			nv = neighbours(view, choose_pivot(cliqctx, &f->P, &f->X), &d);
+			f->cand.len = sortedset_difference(f->P.v, f->P.len, nv, d, f->cand.v);
+#else
+			memcpy(f->cand.v, f->P.v, f->P.len * sizeof(*f->cand.v));
+			f->cand.len = f->P.len;
 #endif
-	nsp_put(&cliqctx->pool, newX);
-	nsp_put(&cliqctx->pool, newP);
+			f->state = FRAME_LOOP;
+			break;
 
-	return ret;
+		case FRAME_KERNEL:
+			ret = bitkernel_next(cliqctx);
+			if (ret)
+				return ret;
+			f->state = FRAME_DONE;
+			break;
+
+		case FRAME_LOOP:
+			if (f->i == f->cand.len || cliqctx->rlen + f->P.len < cliqctx->min_size) {
+				f->state = FRAME_DONE;
+				break;
+			}
+			g = bk_child(cliqctx, f);
+			if (g == NULL)
+				return -1;
+			v = f->cand.v[f->i];
+			nv = neighbours(view, v, &d);
+			g->P.len = sortedset_intersect(f->P.v, f->P.len, nv, d, g->P.v);
+			g->X.len = sortedset_intersect(f->X.v, f->X.len, nv, d, g->X.v);
+
+			/* Now g->P := P \intersect N(v) and g->X := X \intersect N(v). */
+			f->state = FRAME_RETURN;
+			cliqctx->R[cliqctx->rlen++] = view->fg.nodes[v];
+			cliqctx->depth++;
+			break;
+
+		case FRAME_RETURN:
+			v = f->cand.v[f->i++];
+			nodeset_remove(&f->P, v);
+			nodeset_insert(&f->X, v);
+			f->state = FRAME_LOOP;
+			break;
+
+		case FRAME_DONE:
+			bk_pop(cliqctx);
+			break;
+		}
+	}
+	return 0;
 }
 #undef USE_PIVOT
 
 
-extern int
-component_iterate_maximal_cliques(const struct Component *comp, int (*callback)(const struct Node **set, size_t count, void *ctx), void *ctx)
+/*
+ * The outer level of the recursion is handled differently, following
+ * Eppstein, Löffler and Strash: Order the nodes of the component by
+ * degeneracy (repeatedly removing a node of minimum remaining degree),
+ * and for each node v, enumerate the maximal cliques containing v in
+ * which v comes first in that order, i.e. call BK with R = {v}, P =
+ * the neighbours of v later in the order, and X = the neighbours of v
+ * earlier in the order. Every P then has at most d nodes, where d is
+ * the degeneracy of the component, which for sparse real-world graphs
+ * is tiny compared to the number of nodes. Seeding P with the entire
+ * component would instead make the top-level pivoting and set
+ * operations cost O(n) for every branch.
+ *
+ * A clique of k nodes lies within the (k-1)-core, and a maximal
+ * clique of the (k-1)-core with at least k nodes is maximal in the
+ * whole graph (a node extending it would be in the k-core). Core
+ * numbers never decrease along a degeneracy order, so with a minimum
+ * clique size k, the (k-1)-core is a suffix order[first...] of it:
+ * the branches before first are skipped, and so are the nodes before
+ * it in the X of the others. Their P are within the core anyway.
+ */
+static void
+cliqview_destroy(struct cliqview *view)
 {
-	struct cliqctx cliqctx;
-	struct NodeSet *P, *X;
-	const struct Node *node;
-	int ret = -1;
-
-	cliqctx.user_cb = callback;
-	cliqctx.user_ctx = ctx;
+	free(view->order);
+	free(view->rank);
+	frozen_destroy(&view->fg);
+}
 
-	nsp_init(&cliqctx.pool);
-	cliqctx.R = nodeset_alloc(0);
-	P = nodeset_alloc(comp->node_count);
-	X = nodeset_alloc(comp->node_count);
-  
-	if (cliqctx.R == NULL || P == NULL || X == NULL)
-		goto out;
+/* Compute the degeneracy order of view->fg; destroys the view on failure. */
+static int
+cliqview_order(struct cliqview *view, uint32_t min_size)
+{
+	uint32_t n = view->fg.node_count;
+	size_t nn = n ? n : 1;
+	uint32_t *core;
+	int64_t degeneracy = -1;
 
-	STAILQ_FOREACH(node, &comp->nodes, complink) {
-		assert(nodeset_append(P, node) == 0);
+	core = malloc(nn * sizeof(*core));
+	view->order = malloc(nn * sizeof(*view->order));
+	view->rank = malloc(nn * sizeof(*view->rank));
+	if (core && view->order && view->rank)
+		degeneracy = frozen_core_numbers(&view->fg, core, view->order);
+	if (degeneracy < 0) {
+		free(core);
+		cliqview_destroy(view);
+		return -1;
 	}
-	nodeset_sort(P);
-	assert(P->len == comp->node_count);
-	assert(X->len == 0);
-	assert(cliqctx.R->len == 0);
+	view->degeneracy = degeneracy;
+	for (uint32_t i = 0; i < n; ++i)
+		view->rank[view->order[i]] = i;
+	while (view->first < n && core[view->order[view->first]] + 1 < min_size)
+		view->first++;
+	free(core);
+	return 0;
+}
 
-	ret = BronKerbosch(&cliqctx, P, X);
-  
-out:
-	nodeset_free(cliqctx.R);
-	nodeset_free(P);
-	nodeset_free(X);
-	nsp_destroy(&cliqctx.pool);
-	return ret;
+static int
+cliqview_init(struct cliqview *view, const struct Component *comp, uint32_t *scratch, uint32_t min_size)
+{
+	memset(view, 0, sizeof(*view));
+	/* Leave the view empty if the component is too small. */
+	if (comp->node_count < min_size)
+		return 0;
+	if (component_freeze(comp, &view->fg, FROZEN_SYMMETRIC, scratch))
+		return -1;
+	return cliqview_order(view, min_size);
 }
 
-extern int
-graph_iterate_maximal_cliques(const struct Graph *gra, int (*callback)(const struct Node **nodes, size_t count, void *ctx), void *ctx)
+/* Set up the search for the maximal cliques whose first node in degeneracy order is view->order[i]. */
+static int
+bk_start(struct cliqctx *cliqctx, const struct cliqview *view, uint32_t i)
 {
-	const struct Component *comp;
-	unsigned required_flags = GRAPH_NOPARALLEL | GRAPH_NOLOOP | GRAPH_DUAL;
-	if ((gra->flags & required_flags) != required_flags) {
-		errno = EINVAL;
+	struct bkframe *f;
+	uint32_t v = view->order[i];
+	uint32_t d;
+	const uint32_t *nv = neighbours(view, v, &d);
+
+	assert(cliqctx->rlen == 0 && cliqctx->depth == 0);
+	if (nsa_reserve(cliqctx, view->degeneracy))
+		return -1;
+	f = &cliqctx->frames[0];
+	/* P ∪ X is N(v), and X grows only by what leaves P. */
+	if (nsa_frame_x(&cliqctx->sets, f, 0, d))
 		return -1;
+	nsa_frame(&cliqctx->sets, f, 0);
+	f->i = 0;
+	f->state = FRAME_ENTER;
+	/* Filtering preserves the order. */
+	for (uint32_t k = 0; k < d; ++k) {
+		uint32_t u = nv[k];
+		if (view->rank[u] > i)
+			f->P.v[f->P.len++] = u;
+		else if (view->rank[u] >= view->first)
+			f->X.v[f->X.len++] = u;
 	}
 
-	TAILQ_FOREACH(comp, &gra->components, list) {
-		int r = component_iterate_maximal_cliques(comp, callback, ctx);
-		if (r)
-			return r;
-	}
+	cliqctx->view = view;
+	cliqctx->R[cliqctx->rlen++] = view->fg.nodes[v];
+	cliqctx->depth = 1;
 	return 0;
 }
+
+/*
+ * Report the maximal cliques whose first node in degeneracy order is
+ * view->order[i]. With a result budget, the monitor is checked after
+ * every clique, so that the budget is exact in serial runs.
+ */
+static int
+cliqview_branch(struct cliqctx *cliqctx, const struct cliqview *view, uint32_t i)
+{
+	struct cliqmonitor *mon = cliqctx->mon;
+	int ret;
+
+	if (mon) {
+		if (mon->serial) {
+			mon->pos.component = cliqctx->comp_index;
+			mon->pos.branch = i;
+			mon->branches = view->fg.node_count;
+			mon->cliques_before = mon->cliques + (cliqctx->stats.cliques - cliqctx->mon_cliques);
+		}
+		if (monitor_check(cliqctx))
+			return -1;
+	}
+	ret = bk_start(cliqctx, view, i);
+	while (ret == 0 && (ret = bk_next(cliqctx)) > 0) {
+		ret = report_clique(cliqctx);
+		if (ret == 0 && mon && mon->opt->max_cliques)
+			ret = monitor_check(cliqctx);
+	}
+	bk_abort(cliqctx);
+	return ret;
+}
+
+/* Report the maximal cliques of comp, starting at the top-level branch from. */
+static int
+component_cliques(struct cliqctx *cliqctx, const struct Component *comp, uint32_t *scratch, uint32_t from)
+{
+	struct cliqview view;
+	int ret = 0;
+
+	if (cliqview_init(&view, comp, scratch, cliqctx->min_size))
+		return -1;
+	if (from < view.first)
+		from = view.first;
+	for (uint32_t i = from; i < view.fg.node_count && ret == 0; ++i)
+		ret = cliqview_branch(cliqctx, &view, i);
+	cliqview_destroy(&view);
+	return ret;
+}
+
+static int
+cliqctx_init(struct cliqctx *cliqctx, const struct clique_options *opt,
+	     int (*callback)(const struct Node **, size_t, void *), void *ctx)
+{
+	memset(cliqctx, 0, sizeof(*cliqctx));
+	cliqctx->user_cb = callback;
+	cliqctx->user_ctx = ctx;
+	cliqctx->pivot = opt->pivot;
+	cliqctx->min_size = opt->min_size;
+	return 0;
+}
+
+static void
+cliqctx_destroy(struct cliqctx *cliqctx)
+{
+	bk_abort(cliqctx);
+	free(cliqctx->R);
+	free(cliqctx->frames);
+	nsa_destroy(&cliqctx->sets);
+	bitkernel_destroy(&cliqctx->bits);
+}
+
+static void
+stats_add(struct clique_stats *sum, const struct clique_stats *st)
+{
+	sum->calls += st->calls;
+	sum->cliques += st->cliques;
+}
+
+extern int
+component_iterate_maximal_cliques(const struct Component *comp, int (*callback)(const struct Node **set, size_t count, void *ctx), void *ctx)
+{
+	static const struct clique_options defaults;
+	struct cliqctx cliqctx;
+	int ret = -1;
+
+	if (cliqctx_init(&cliqctx, &defaults, callback, ctx) == 0)
+		ret = component_cliques(&cliqctx, comp, NULL, 0);
+	cliqctx_destroy(&cliqctx);
+	return ret;
+}
+
+static int
+iterate_serial(const struct Graph *gra, const struct clique_options *opt, struct cliqmonitor *mon,
+	       int (*callback)(const struct Node **nodes, size_t count, void *ctx), void *ctx)
+{
+	const struct Component *comp;
+	struct cliqctx cliqctx;
+	uint32_t *scratch;
+	uint32_t ci = 0;
+	int ret = -1;
+
+	scratch = malloc((gra->node_count ? gra->node_count : 1) * sizeof(*scratch));
+	if (cliqctx_init(&cliqctx, opt, callback, ctx) || scratch == NULL)
+		goto out;
+	cliqctx.mon = mon;
+	ret = 0;
+	TAILQ_FOREACH(comp, &gra->components, list) {
+		if (ci >= opt->resume.component) {
+			cliqctx.comp_index = ci;
+			ret = component_cliques(&cliqctx, comp, scratch, ci == opt->resume.component ? opt->resume.branch : 0);
+			if (ret)
+				break;
+		}
+		ci++;
+	}
+	if (mon) {
+		uint64_t calls, cliques;
+		monitor_flush(&cliqctx, &calls, &cliques);
+		if (ret == 0) {
+			/* Resuming from here finds nothing more. */
+			mon->pos.component = ci;
+			mon->pos.branch = 0;
+			mon->branches = 0;
+			mon->cliques_before = cliques;
+		}
+	}
+	if (opt->stats)
+		stats_add(opt->stats, &cliqctx.stats);
+out:
+	cliqctx_destroy(&cliqctx);
+	free(scratch);
+	return ret;
+}
+
+
+/*
+ * The iterator is the serial enumeration turned inside out: it keeps
+ * the current component's view and the index of its next top-level
+ * branch, and bk_next() resumes the search where the previous call
+ * left it.
+ */
+struct clique_iter {
+	struct cliqctx         cliqctx;
+	const struct clique_options *opt;
+	const struct Component *next_comp;
+	struct cliqview        view;
+	bool                   have_view;
+	uint32_t               branch;  /* next top-level branch of view */
+	uint32_t               *scratch;
+};
+
+extern struct clique_iter *
+clique_iter_begin(const struct Graph *gra, const struct clique_options *opt)
+{
+	static const struct clique_options defaults;
+	struct clique_iter *it;
+
+	if (opt == NULL)
+		opt = &defaults;
+	it = calloc(1, sizeof(*it));
+	if (it == NULL)
+		return NULL;
+	it->scratch = malloc((gra->node_count ? gra->node_count : 1) * sizeof(*it->scratch));
+	if (it->scratch == NULL) {
+		free(it);
+		return NULL;
+	}
+	cliqctx_init(&it->cliqctx, opt, NULL, NULL);
+	it->opt = opt;
+	it->next_comp = TAILQ_FIRST(&gra->components);
+	if (opt->stats)
+		memset(opt->stats, 0, sizeof(*opt->stats));
+	return it;
+}
+
+extern ssize_t
+clique_iter_next(struct clique_iter *it, const struct Node ***nodes)
+{
+	struct cliqctx *cliqctx = &it->cliqctx;
+	int ret;
+
+	while (1) {
+		if (cliqctx->depth > 0) {
+			ret = bk_next(cliqctx);
+			if (ret > 0) {
+				*nodes = cliqctx->R;
+				return cliqctx->rlen;
+			}
+			if (ret < 0) {
+				bk_abort(cliqctx);
+				return -1;
+			}
+		}
+		if (it->have_view && it->branch < it->view.fg.node_count) {
+			if (bk_start(cliqctx, &it->view, it->branch++))
+				return -1;
+			continue;
+		}
+		if (it->have_view) {
+			cliqview_destroy(&it->view);
+			it->have_view = false;
+		}
+		if (it->next_comp == NULL)
+			return 0;
+		if (cliqview_init(&it->view, it->next_comp, it->scratch, cliqctx->min_size))
+			return -1;
+		it->have_view = true;
+		it->branch = it->view.first;
+		it->next_comp = TAILQ_NEXT(it->next_comp, list);
+	}
+}
+
+extern void
+clique_iter_end(struct clique_iter *it)
+{
+	if (it == NULL)
+		return;
+	if (it->opt->stats)
+		stats_add(it->opt->stats, &it->cliqctx.stats);
+	if (it->have_view)
+		cliqview_destroy(&it->view);
+	cliqctx_destroy(&it->cliqctx);
+	free(it->scratch);
+	free(it);
+}
+
+/*
+ * Parallel enumeration. Every worker has its own cliqctx (so its own
+ * R and pools), and a deque of tasks, each of which is a range of
+ * top-level branches [lo, hi) of some component. A worker runs a task
+ * by repeatedly splitting off the upper half of its range onto its
+ * own deque until a single branch remains, then running that. The
+ * owner pops from the tail of its deque, so it continues with the
+ * smallest and most recently split range; idle workers steal from
+ * the head, where the largest ranges are. When there is nothing to
+ * pop or steal, a worker claims the next component and builds its
+ * view. Components are thus processed concurrently, while a large
+ * component is shared by all workers which have run out of work.
+ *
+ * The views are reference counted by the tasks referring to them;
+ * pending counts the tasks not yet completed (including a claimed
+ * component), so that a worker finding nothing to do knows whether
+ * more work may still appear. A component is claimed and pending
+ * incremented under the same lock, so pending cannot be observed to
+ * be zero while components remain in flight.
+ *
+ * Once some callback returns non-zero (or something fails), the
+ * workers stop as soon as their current branch returns; tasks left on
+ * the deques are then discarded.
+ *
+ * The components have disjoint sets of nodes, so all workers can
+ * share the scratch array used by component_freeze().
+ */
+
+struct cliqtask {
+	struct cliqview *view;
+	uint32_t        lo, hi;
+};
+
+struct cliqdeque {
+	pthread_mutex_t lock;
+	struct cliqtask *tasks;
+	size_t          head, tail, cap;
+};
+
+struct cliqpool;
+
+struct cliqworker {
+	struct cliqpool   *pool;
+	unsigned          id;
+	pthread_t         tid;
+	struct cliqctx    cliqctx;
+	struct cliqdeque  deque;
+};
+
+struct cliqpool {
+	int (*user_cb)(const struct Node **, size_t, void *);
+	void              **ctxs;
+	bool              serialize;
+	pthread_mutex_t   cb_lock;
+
+	pthread_mutex_t   lock;       /* protects next_comp and comp_index */
+	const struct Component *next_comp;
+	uint32_t          comp_index; /* of next_comp */
+	struct clique_position resume;
+	struct cliqmonitor *mon;
+	uint32_t          *scratch;
+
+	unsigned          nworkers;
+	struct cliqworker *workers;
+	uint64_t          pending;
+	int               ret;        /* first non-zero result; workers stop when set */
+};
+
+static int
+deque_push(struct cliqdeque *dq, struct cliqtask task)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->tail == dq->cap) {
+		if (dq->head > 0) {
+			memmove(dq->tasks, dq->tasks + dq->head, (dq->tail - dq->head) * sizeof(*dq->tasks));
+			dq->tail -= dq->head;
+			dq->head = 0;
+		} else {
+			size_t newcap = dq->cap ? 2*dq->cap : 64;
+			struct cliqtask *new = realloc(dq->tasks, newcap * sizeof(*new));
+			if (new) {
+				dq->tasks = new;
+				dq->cap = newcap;
+			} else {
+				ret = -1;
+			}
+		}
+	}
+	if (ret == 0)
+		dq->tasks[dq->tail++] = task;
+	pthread_mutex_unlock(&dq->lock);
+	return ret;
+}
+
+static bool
+deque_pop(struct cliqdeque *dq, struct cliqtask *task, bool steal)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->head < dq->tail) {
+		*task = steal ? dq->tasks[dq->head++] : dq->tasks[--dq->tail];
+		found = true;
+		if (dq->head == dq->tail)
+			dq->head = dq->tail = 0;
+	}
+	pthread_mutex_unlock(&dq->lock);
+	return found;
+}
+
+static void
+pool_fail(struct cliqpool *pool, int ret)
+{
+	int expected = 0;
+	__atomic_compare_exchange_n(&pool->ret, &expected, ret, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static bool
+pool_stopped(struct cliqpool *pool)
+{
+	return __atomic_load_n(&pool->ret, __ATOMIC_RELAXED) != 0;
+}
+
+static void
+view_put(struct cliqview *view)
+{
+	if (__atomic_sub_fetch(&view->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		cliqview_destroy(view);
+		free(view);
+	}
+}
+
+static void
+task_done(struct cliqpool *pool, struct cliqtask *task)
+{
+	view_put(task->view);
+	__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_RELEASE);
+}
+
+/* The callback seen by BronKerbosch() in a worker. */
+static int
+worker_cb(const struct Node **nodes, size_t count, void *ctx)
+{
+	struct cliqworker *w = ctx;
+	struct cliqpool *pool = w->pool;
+	int ret;
+
+	if (pool_stopped(pool))
+		return -1;
+	if (pool->serialize) {
+		pthread_mutex_lock(&pool->cb_lock);
+		ret = (*pool->user_cb)(nodes, count, pool->ctxs[0]);
+		pthread_mutex_unlock(&pool->cb_lock);
+	} else {
+		ret = (*pool->user_cb)(nodes, count, pool->ctxs[w->id]);
+	}
+	if (ret)
+		pool_fail(pool, ret);
+	return ret;
+}
+
+static void
+worker_run(struct cliqworker *w, struct cliqtask task)
+{
+	struct cliqpool *pool = w->pool;
+
+	while (task.hi - task.lo > 1 && !pool_stopped(pool)) {
+		struct cliqtask upper = { task.view, task.lo + (task.hi - task.lo)/2, task.hi };
+
+		__atomic_add_fetch(&task.view->refs, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&pool->pending, 1, __ATOMIC_RELAXED);
+		if (deque_push(&w->deque, upper)) {
+			task_done(pool, &upper);
+			pool_fail(pool, -1);
+			break;
+		}
+		task.hi = upper.lo;
+	}
+	if (!pool_stopped(pool) && task.lo < task.hi) {
+		int ret = cliqview_branch(&w->cliqctx, task.view, task.lo);
+		if (ret)
+			pool_fail(pool, ret);
+	}
+	task_done(pool, &task);
+}
+
+static bool
+worker_find_task(struct cliqworker *w, struct cliqtask *task)
+{
+	struct cliqpool *pool = w->pool;
+	const struct Component *comp;
+	uint32_t ci;
+
+	if (deque_pop(&w->deque, task, false))
+		return true;
+	for (unsigned k = 1; k < pool->nworkers; ++k) {
+		if (deque_pop(&pool->workers[(w->id + k) % pool->nworkers].deque, task, true))
+			return true;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	comp = pool->next_comp;
+	ci = pool->comp_index;
+	if (comp) {
+		pool->next_comp = TAILQ_NEXT(comp, list);
+		pool->comp_index++;
+		__atomic_add_fetch(&pool->pending, 1, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	if (comp == NULL)
+		return false;
+	if (pool->mon)
+		__atomic_store_n(&pool->mon->pos.component, ci + 1, __ATOMIC_RELAXED);
+
+	task->view = malloc(sizeof(*task->view));
+	if (task->view == NULL || cliqview_init(task->view, comp, pool->scratch, w->cliqctx.min_size)) {
+		free(task->view);
+		pool_fail(pool, -1);
+		__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_RELEASE);
+		return false;
+	}
+	task->view->refs = 1;
+	task->lo = task->view->first;
+	if (ci == pool->resume.component && task->lo < pool->resume.branch)
+		task->lo = pool->resume.branch;
+	task->hi = task->view->fg.node_count;
+	if (task->lo > task->hi)
+		task->lo = task->hi;
+	return true;
+}
+
+static void *
+worker_main(void *arg)
+{
+	struct cliqworker *w = arg;
+	struct cliqpool *pool = w->pool;
+	struct cliqtask task;
+	long backoff = 0;
+
+	while (!pool_stopped(pool)) {
+		if (worker_find_task(w, &task)) {
+			worker_run(w, task);
+			backoff = 0;
+			continue;
+		}
+		if (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0) {
+			bool done;
+			pthread_mutex_lock(&pool->lock);
+			done = pool->next_comp == NULL;
+			pthread_mutex_unlock(&pool->lock);
+			if (done)
+				break;
+			continue;
+		}
+		/* Others are busy, but may split off work. */
+		backoff = backoff ? (backoff < 1000000 ? 2*backoff : backoff) : 10000;
+		nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = backoff }, NULL);
+	}
+	return NULL;
+}
+
+static int
+iterate_parallel(const struct Graph *gra, const struct clique_options *opt, struct cliqmonitor *mon,
+		 int (*callback)(const struct Node **nodes, size_t count, void *ctx), void **ctxs)
+{
+	struct cliqpool pool;
+	unsigned nthreads = opt->threads;
+	unsigned started = 0;
+	struct cliqtask task;
+
+	memset(&pool, 0, sizeof(pool));
+	pool.user_cb = callback;
+	pool.ctxs = ctxs;
+	pool.serialize = opt->serialize;
+	pool.next_comp = TAILQ_FIRST(&gra->components);
+	while (pool.next_comp && pool.comp_index < opt->resume.component) {
+		pool.next_comp = TAILQ_NEXT(pool.next_comp, list);
+		pool.comp_index++;
+	}
+	pool.resume = opt->resume;
+	pool.mon = mon;
+	pool.nworkers = nthreads;
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_mutex_init(&pool.cb_lock, NULL);
+	pool.scratch = malloc((gra->node_count ? gra->node_count : 1) * sizeof(*pool.scratch));
+	pool.workers = calloc(nthreads, sizeof(*pool.workers));
+	if (pool.scratch == NULL || pool.workers == NULL) {
+		pool.ret = -1;
+		goto out;
+	}
+
+	for (unsigned t = 0; t < nthreads; ++t) {
+		struct cliqworker *w = &pool.workers[t];
+		w->pool = &pool;
+		w->id = t;
+		pthread_mutex_init(&w->deque.lock, NULL);
+		if (cliqctx_init(&w->cliqctx, opt, worker_cb, w))
+			pool.ret = -1;
+		w->cliqctx.mon = mon;
+	}
+	if (pool.ret == 0) {
+		for (started = 0; started < nthreads; ++started) {
+			if (pthread_create(&pool.workers[started].tid, NULL, worker_main, &pool.workers[started]))
+				break;
+		}
+		if (started == 0)
+			worker_main(&pool.workers[0]);
+		for (unsigned t = 0; t < started; ++t)
+			pthread_join(pool.workers[t].tid, NULL);
+	}
+
+	for (unsigned t = 0; t < nthreads; ++t) {
+		struct cliqworker *w = &pool.workers[t];
+		/* Only left over if we stopped early. */
+		while (deque_pop(&w->deque, &task, false))
+			view_put(task.view);
+		free(w->deque.tasks);
+		pthread_mutex_destroy(&w->deque.lock);
+		if (opt->stats)
+			stats_add(opt->stats, &w->cliqctx.stats);
+		if (mon) {
+			uint64_t calls, cliques;
+			monitor_flush(&w->cliqctx, &calls, &cliques);
+		}
+		cliqctx_destroy(&w->cliqctx);
+	}
+out:
+	free(pool.workers);
+	free(pool.scratch);
+	pthread_mutex_destroy(&pool.lock);
+	pthread_mutex_destroy(&pool.cb_lock);
+	return pool.ret;
+}
+
+extern int
+graph_iterate_maximal_cliques_opt(const struct Graph *gra, const struct clique_options *opt,
+				  int (*callback)(const struct Node **nodes, size_t count, void *ctx), void **ctxs)
+{
+	struct cliqmonitor monitor, *mon = NULL;
+	int ret;
+
+	if (opt->stats)
+		memset(opt->stats, 0, sizeof(*opt->stats));
+	if (monitor_wanted(opt)) {
+		monitor_init(&monitor, opt);
+		mon = &monitor;
+	}
+	if (opt->threads <= 1)
+		ret = iterate_serial(gra, opt, mon, callback, ctxs[0]);
+	else
+		ret = iterate_parallel(gra, opt, mon, callback, ctxs);
+	if (mon) {
+		if (opt->progress && (ret == 0 || mon->exhausted))
+			monitor_report(mon, monitor_elapsed(mon), mon->calls, mon->cliques);
+		if (ret == -1 && mon->exhausted)
+			errno = ETIMEDOUT;
+		pthread_mutex_destroy(&mon->lock);
+	}
+	return ret;
+}
+
+extern int
+graph_iterate_maximal_cliques(const struct Graph *gra, int (*callback)(const struct Node **nodes, size_t count, void *ctx), void *ctx)
+{
+	static const struct clique_options defaults;
+
+	return graph_iterate_maximal_cliques_opt(gra, &defaults, callback, &ctx);
+}
+
+extern int
+graph_iterate_maximal_cliques_parallel(const struct Graph *gra, unsigned nthreads, bool serialize,
+				       int (*callback)(const struct Node **nodes, size_t count, void *ctx), void **ctxs)
+{
+	struct clique_options opt = { .threads = nthreads, .serialize = serialize };
+
+	return graph_iterate_maximal_cliques_opt(gra, &opt, callback, ctxs);
+}
+
+/*
+ * Counting runs the ordinary enumeration with a callback which only
+ * bumps a histogram. Every worker gets its own histogram (the
+ * callback is not serialized), so nothing is shared until they are
+ * summed at the end.
+ */
+struct cliqcount {
+	uint64_t  *by_size;
+	size_t    len;
+};
+
+static int
+count_cb(const struct Node **nodes, size_t count, void *ctx)
+{
+	struct cliqcount *cc = ctx;
+
+	(void) nodes;
+	if (count >= cc->len) {
+		size_t len = 2*count > 16 ? 2*count : 16;
+		uint64_t *new = realloc(cc->by_size, len * sizeof(*new));
+		if (!new)
+			return -1;
+		memset(new + cc->len, 0, (len - cc->len) * sizeof(*new));
+		cc->by_size = new;
+		cc->len = len;
+	}
+	cc->by_size[count]++;
+	return 0;
+}
+
+extern int
+graph_count_maximal_cliques(const struct Graph *gra, const struct clique_options *opt, struct clique_counts *counts)
+{
+	static const struct clique_options defaults;
+	struct clique_options o = opt ? *opt : defaults;
+	unsigned n = o.threads > 1 ? o.threads : 1;
+	struct cliqcount *cc = calloc(n, sizeof(*cc));
+	void **ctxs = calloc(n, sizeof(*ctxs));
+	size_t len = 0;
+	int ret = -1;
+
+	memset(counts, 0, sizeof(*counts));
+	if (!cc || !ctxs)
+		goto out;
+	for (unsigned t = 0; t < n; ++t)
+		ctxs[t] = &cc[t];
+	o.serialize = false;
+	ret = graph_iterate_maximal_cliques_opt(gra, &o, count_cb, ctxs);
+	/* When a budget runs out, the counts so far are still of interest. */
+	if (ret && errno != ETIMEDOUT)
+		goto out;
+
+	for (unsigned t = 0; t < n; ++t) {
+		for (size_t s = 0; s < cc[t].len; ++s) {
+			if (cc[t].by_size[s] && s + 1 > len)
+				len = s + 1;
+		}
+	}
+	counts->by_size = calloc(len ? len : 1, sizeof(*counts->by_size));
+	if (!counts->by_size) {
+		ret = -1;
+		errno = ENOMEM;
+		goto out;
+	}
+	for (unsigned t = 0; t < n; ++t) {
+		for (size_t s = 0; s < cc[t].len && s < len; ++s)
+			counts->by_size[s] += cc[t].by_size[s];
+	}
+	for (size_t s = 0; s < len; ++s)
+		counts->total += counts->by_size[s];
+	counts->max_size = len ? len - 1 : 0;
+
+out:
+	for (unsigned t = 0; cc && t < n; ++t)
+		free(cc[t].by_size);
+	free(cc);
+	free(ctxs);
+	return ret;
+}
+
+/*
+ * The maximal cliques containing a clique Q are Q together with the
+ * maximal cliques of the subgraph induced by S, the common
+ * neighbourhood of Q: a node extending such a clique is adjacent to
+ * all of Q, so it is in S. S is usually tiny compared to the
+ * component, so we build a view of just G[S], numbering its nodes in
+ * order of ->index, and run the usual search on it.
+ *
+ * With GRAPH_DUAL, the neighbours of a node are the targets of its
+ * edges, and everything stays local. Otherwise an edge is only stored
+ * at one of its endpoints, and finding the neighbours of Q, and then
+ * the edges of G[S], each take a pass over the edges of the
+ * component; that is still far cheaper than enumerating it.
+ */
+struct cliqquery {
+	const struct Node  **q;        /* the query nodes, by ->index */
+	uint32_t           *qidx;
+	uint32_t           k;
+	uint32_t           **nb;       /* the neighbours of each query node, by ->index */
+	size_t             *nblen, *nbcap;
+	uint32_t           *S;         /* their common neighbours */
+	size_t             ns;
+	uint32_t           *pairs;     /* edges of G[S], as local node numbers */
+	size_t             npairs, pairs_cap;
+	const struct Node  **snodes;
+	int (*user_cb)(const struct Node **, size_t, void *);
+	void               *user_ctx;
+	const struct Node  **buf;      /* Q followed by a clique of G[S] */
+};
+
+static int
+u32_push(uint32_t **v, size_t *len, size_t *cap, uint32_t x)
+{
+	if (*len == *cap) {
+		size_t c = *cap ? 2 * *cap : 16;
+		uint32_t *new = realloc(*v, c * sizeof(*new));
+		if (!new)
+			return -1;
+		*v = new;
+		*cap = c;
+	}
+	(*v)[(*len)++] = x;
+	return 0;
+}
+
+static int
+cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static int
+cmp_node_index(const void *a, const void *b)
+{
+	uint32_t x = (*(const struct Node * const *)a)->index;
+	uint32_t y = (*(const struct Node * const *)b)->index;
+	return (x > y) - (x < y);
+}
+
+/* The position of x in the sorted array v of n elements, or -1. */
+static int64_t
+u32_find(const uint32_t *v, size_t n, uint32_t x)
+{
+	size_t i = sortedset_search(v, n, 0, x);
+	return i < n && v[i] == x ? (int64_t)i : -1;
+}
+
+/* Note the edge {a, b} if it is at a query node. */
+static int
+query_neighbour_edge(struct cliqquery *cq, const struct Node *a, const struct Node *b)
+{
+	int64_t i;
+
+	if ((i = u32_find(cq->qidx, cq->k, a->index)) >= 0 &&
+	    u32_push(&cq->nb[i], &cq->nblen[i], &cq->nbcap[i], b->index))
+		return -1;
+	if ((i = u32_find(cq->qidx, cq->k, b->index)) >= 0 &&
+	    u32_push(&cq->nb[i], &cq->nblen[i], &cq->nbcap[i], a->index))
+		return -1;
+	return 0;
+}
+
+/* Note the edge {a, b} if it is in G[S]; also pick up the nodes of S from the edges at q[0]. */
+static int
+query_subgraph_edge(struct cliqquery *cq, const struct Node *a, const struct Node *b)
+{
+	int64_t i = u32_find(cq->S, cq->ns, a->index);
+	int64_t j = u32_find(cq->S, cq->ns, b->index);
+
+	if (i >= 0 && j >= 0) {
+		if (u32_push(&cq->pairs, &cq->npairs, &cq->pairs_cap, i) ||
+		    u32_push(&cq->pairs, &cq->npairs, &cq->pairs_cap, j))
+			return -1;
+	} else if (i >= 0 && b == cq->q[0]) {
+		cq->snodes[i] = a;
+	} else if (j >= 0 && a == cq->q[0]) {
+		cq->snodes[j] = b;
+	}
+	return 0;
+}
+
+/* Call visit for every edge (other than loops) at any of the nodes, or in comp. */
+static int
+query_scan(struct cliqquery *cq, const struct Graph *gra, const struct Component *comp,
+	   const struct Node **nodes, size_t n,
+	   int (*visit)(struct cliqquery *, const struct Node *, const struct Node *))
+{
+	const struct Node *a;
+	const struct Edge *e;
+
+	if (gra->flags & GRAPH_DUAL) {
+		for (size_t i = 0; i < n; ++i) {
+			SLIST_FOREACH(e, &nodes[i]->out_edges, nodelink) {
+				if (e->tgt != nodes[i] && (*visit)(cq, nodes[i], e->tgt))
+					return -1;
+			}
+		}
+		return 0;
+	}
+	STAILQ_FOREACH(a, &comp->nodes, complink) {
+		SLIST_FOREACH(e, &a->out_edges, nodelink) {
+			if (e->tgt != a && (*visit)(cq, a, e->tgt))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/* Build the symmetric adjacency of G[S] from the pairs; in GRAPH_DUAL graphs, each edge is there twice. */
+static int
+query_freeze(struct cliqquery *cq, struct FrozenGraph *fg)
+{
+	size_t n = cq->ns;
+	uint64_t *fill;
+
+	memset(fg, 0, sizeof(*fg));
+	fg->flags = FROZEN_SYMMETRIC;
+	fg->node_count = n;
+	fg->comp_count = 1;
+	fg->nodes = cq->snodes;
+	cq->snodes = NULL;
+	fg->offset = calloc(n + 1, sizeof(*fg->offset));
+	fg->adj = malloc((cq->npairs ? cq->npairs : 1) * sizeof(*fg->adj));
+	fill = malloc((n + 1) * sizeof(*fill));
+	if (!fg->offset || !fg->adj || !fill) {
+		free(fill);
+		return -1;
+	}
+	for (size_t p = 0; p < cq->npairs; p += 2) {
+		fg->offset[cq->pairs[p] + 1]++;
+		fg->offset[cq->pairs[p+1] + 1]++;
+	}
+	for (size_t i = 0; i < n; ++i)
+		fg->offset[i+1] += fg->offset[i];
+	memcpy(fill, fg->offset, (n + 1) * sizeof(*fill));
+	for (size_t p = 0; p < cq->npairs; p += 2) {
+		fg->adj[fill[cq->pairs[p]]++] = cq->pairs[p+1];
+		fg->adj[fill[cq->pairs[p+1]]++] = cq->pairs[p];
+	}
+	/* Sort, and squeeze out the duplicates, compacting as we go. */
+	fg->adj_count = 0;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t lo = fg->offset[i], hi = fill[i];
+
+		qsort(fg->adj + lo, hi - lo, sizeof(*fg->adj), cmp_u32);
+		fg->offset[i] = fg->adj_count;
+		for (uint64_t x = lo; x < hi; ++x) {
+			if (x == lo || fg->adj[x] != fg->adj[x-1])
+				fg->adj[fg->adj_count++] = fg->adj[x];
+		}
+	}
+	fg->offset[n] = fg->adj_count;
+	free(fill);
+	return 0;
+}
+
+static int
+query_cb(const struct Node **nodes, size_t count, void *ctx)
+{
+	struct cliqquery *cq = ctx;
+
+	memcpy(cq->buf + cq->k, nodes, count * sizeof(*nodes));
+	return (*cq->user_cb)(cq->buf, cq->k + count, cq->user_ctx);
+}
+
+static void
+query_destroy(struct cliqquery *cq)
+{
+	for (uint32_t i = 0; cq->nb && i < cq->k; ++i)
+		free(cq->nb[i]);
+	free(cq->nb);
+	free(cq->nblen);
+	free(cq->nbcap);
+	free(cq->q);
+	free(cq->qidx);
+	free(cq->pairs);
+	free(cq->snodes);
+	free(cq->buf);
+}
+
+extern int
+graph_iterate_cliques_containing(const struct Graph *gra, const struct Node **nodes, size_t n,
+				 int (*callback)(const struct Node **nodes, size_t count, void *ctx), void *ctx)
+{
+	static const struct clique_options defaults;
+	struct cliqquery cq = { .user_cb = callback, .user_ctx = ctx };
+	struct cliqctx cliqctx;
+	struct cliqview view;
+	const struct Component *comp;
+	int ret = -1;
+
+	if (n == 0)
+		return graph_iterate_maximal_cliques(gra, callback, ctx);
+	cq.q = malloc(n * sizeof(*cq.q));
+	cq.qidx = malloc(n * sizeof(*cq.qidx));
+	if (!cq.q || !cq.qidx)
+		goto out;
+	memcpy(cq.q, nodes, n * sizeof(*nodes));
+	qsort(cq.q, n, sizeof(*cq.q), cmp_node_index);
+	comp = cq.q[0]->comp;
+	for (size_t i = 0; i < n; ++i) {
+		if (cq.q[i]->comp != comp) {
+			ret = 0;
+			goto out;
+		}
+		if (cq.k == 0 || cq.q[i] != cq.q[cq.k-1]) {
+			cq.q[cq.k] = cq.q[i];
+			cq.qidx[cq.k++] = cq.q[i]->index;
+		}
+	}
+
+	cq.nb = calloc(cq.k, sizeof(*cq.nb));
+	cq.nblen = calloc(cq.k, sizeof(*cq.nblen));
+	cq.nbcap = calloc(cq.k, sizeof(*cq.nbcap));
+	if (!cq.nb || !cq.nblen || !cq.nbcap ||
+	    query_scan(&cq, gra, comp, cq.q, cq.k, query_neighbour_edge))
+		goto out;
+	/* With GRAPH_DUAL, an edge between two query nodes has been seen from both. */
+	for (uint32_t i = 0; i < cq.k; ++i) {
+		size_t len = 0;
+
+		qsort(cq.nb[i], cq.nblen[i], sizeof(*cq.nb[i]), cmp_u32);
+		for (size_t x = 0; x < cq.nblen[i]; ++x) {
+			if (x == 0 || cq.nb[i][x] != cq.nb[i][x-1])
+				cq.nb[i][len++] = cq.nb[i][x];
+		}
+		cq.nblen[i] = len;
+	}
+	/* Q must be a clique; its nodes are then not in S, having no loops. */
+	for (uint32_t i = 0; i < cq.k; ++i) {
+		for (uint32_t j = 0; j < cq.k; ++j) {
+			if (i != j && u32_find(cq.nb[i], cq.nblen[i], cq.qidx[j]) < 0) {
+				ret = 0;
+				goto out;
+			}
+		}
+	}
+	cq.S = cq.nb[0];
+	cq.ns = cq.nblen[0];
+	for (uint32_t i = 1; i < cq.k; ++i)
+		cq.ns = sortedset_intersect(cq.S, cq.ns, cq.nb[i], cq.nblen[i], cq.S);
+
+	if (cq.ns == 0) {
+		/* Q is maximal by itself. */
+		ret = (*callback)(cq.q, cq.k, ctx);
+		goto out;
+	}
+	cq.snodes = calloc(cq.ns, sizeof(*cq.snodes));
+	if (!cq.snodes)
+		goto out;
+	if (gra->flags & GRAPH_DUAL) {
+		/* The nodes of S are exactly the neighbours of q[0] in it. */
+		const struct Edge *e;
+
+		SLIST_FOREACH(e, &cq.q[0]->out_edges, nodelink) {
+			int64_t i = u32_find(cq.S, cq.ns, e->tgt->index);
+			if (i >= 0)
+				cq.snodes[i] = e->tgt;
+		}
+		if (query_scan(&cq, gra, comp, cq.snodes, cq.ns, query_subgraph_edge))
+			goto out;
+	} else if (query_scan(&cq, gra, comp, NULL, 0, query_subgraph_edge)) {
+		goto out;
+	}
+
+	memset(&view, 0, sizeof(view));
+	if (query_freeze(&cq, &view.fg)) {
+		cliqview_destroy(&view);
+		goto out;
+	}
+	if (cliqview_order(&view, 0))
+		goto out;
+	cq.buf = malloc((cq.k + view.degeneracy + 1) * sizeof(*cq.buf));
+	if (cq.buf == NULL || cliqctx_init(&cliqctx, &defaults, query_cb, &cq)) {
+		cliqview_destroy(&view);
+		goto out;
+	}
+	memcpy(cq.buf, cq.q, cq.k * sizeof(*cq.buf));
+	ret = 0;
+	for (uint32_t i = view.first; i < view.fg.node_count && ret == 0; ++i)
+		ret = cliqview_branch(&cliqctx, &view, i);
+	cliqctx_destroy(&cliqctx);
+	cliqview_destroy(&view);
+
+out:
+	query_destroy(&cq);
+	return ret;
+}
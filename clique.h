@@ -2,6 +2,8 @@
 #define CLIQUE_H_INCLUDED
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 #include "graph.h"
 
@@ -16,8 +18,10 @@
  * The callback function should not store copies of the nodes argument;
  * the array should be copied if necessary.
  *
- * The struct Graph must have been created with all of the flags
- * GRAPH_NOLOOP|GRAPH_DUAL|GRAPH_NOPARALLEL.
+ * The graph is taken as undirected: an edge in either direction joins
+ * its endpoints, and loops and parallel edges are ignored. So any
+ * flags will do; GRAPH_UNDIRECTED|GRAPH_NOPARALLEL stores each edge
+ * once, with half the memory of GRAPH_DUAL.
  *
  */
 
@@ -28,5 +32,179 @@ component_iterate_maximal_cliques(const struct Component *comp, int (*cb)(const
 int
 graph_iterate_maximal_cliques(const struct Graph *gra, int (*cb)(const struct Node **nodes, size_t count, void *ctx), void *ctx);
 
+/*
+ * Like graph_iterate_maximal_cliques(), but using nthreads
+ * threads. Different components, and different parts of large
+ * components, are handled concurrently, so the cliques are reported
+ * in no particular order. If serialize is true, calls of cb are
+ * protected by a mutex, and all get ctxs[0] as context; otherwise,
+ * the callback may be called concurrently from the worker threads,
+ * and the i'th worker passes ctxs[i], so ctxs must have nthreads
+ * entries.
+ */
+int
+graph_iterate_maximal_cliques_parallel(const struct Graph *gra, unsigned nthreads, bool serialize,
+				       int (*cb)(const struct Node **nodes, size_t count, void *ctx), void **ctxs);
+
+/*
+ * Like graph_iterate_maximal_cliques(), but only the maximal cliques
+ * containing all of the n given nodes (duplicates are ignored), with
+ * those nodes first. There are none unless the nodes form a clique;
+ * with n == 0, all are reported. Only the common neighbourhood of the
+ * nodes is searched, so this is fast even in huge graphs, as long as
+ * the nodes do not have huge degrees (without GRAPH_DUAL, finding
+ * the neighbours still takes a pass over the edges of the component).
+ * graph_find_node() looks nodes up by identifier.
+ */
+int
+graph_iterate_cliques_containing(const struct Graph *gra, const struct Node **nodes, size_t n,
+				 int (*cb)(const struct Node **nodes, size_t count, void *ctx), void *ctx);
+
+
+/*
+ * The pivot rule only affects performance, not the cliques reported;
+ * CLIQUE_PIVOT_DEGREE is mostly of interest for comparison.
+ */
+enum clique_pivot {
+	CLIQUE_PIVOT_TOMITA,  /* maximize |P ∩ N(u)| */
+	CLIQUE_PIVOT_DEGREE,  /* largest degree in the graph */
+};
+
+struct clique_stats {
+	uint64_t  calls;    /* recursive calls of Bron-Kerbosch */
+	uint64_t  cliques;  /* maximal cliques found */
+};
+
+/*
+ * The position of the search: The components are numbered in
+ * graph_iterate_components() order, and within a component, the
+ * maximal cliques are found by one top-level branch for each node,
+ * in degeneracy order. For a given graph, both orders are
+ * deterministic, and the serial enumeration reports the cliques in
+ * the same order every time.
+ */
+struct clique_position {
+	uint32_t  component;
+	uint32_t  branch;
+};
+
+/*
+ * Reported periodically (see struct clique_options). pos is the
+ * branch in progress, and cliques_before the number of cliques
+ * reported before it, so every clique up to then has been passed to
+ * the callback; resuming from pos reports the cliques from
+ * cliques_before on, in the same order. This only holds for serial
+ * runs; with several threads, pos.component is the number of
+ * components started, and pos.branch and cliques_before are 0.
+ */
+struct clique_progress {
+	double                  elapsed;    /* seconds */
+	uint64_t                calls;
+	uint64_t                cliques;
+	struct clique_position  pos;
+	uint32_t                branches;   /* top-level branches of the current component */
+	uint64_t                cliques_before;
+};
+
+/*
+ * All fields may be left zero for the default behaviour. With
+ * min_size, only the maximal cliques with at least that many nodes
+ * are reported; the search is then restricted to the (min_size-1)-core
+ * of each component, and branches which cannot reach min_size nodes
+ * are cut.
+ *
+ * The budgets are checked every few thousand recursive calls and at
+ * every top-level branch; once one is exceeded, the enumeration stops
+ * and returns -1 with errno set to ETIMEDOUT. Zero means no limit.
+ *
+ * If progress is set, it is called about every progress_interval
+ * seconds (default 1), from whichever thread notices; calls are
+ * serialized. It is called once more at the end if the enumeration
+ * completes or runs out of budget; pos is then where to resume (past
+ * the last component if it completed).
+ * The enumeration starts at resume, skipping everything before it.
+ *
+ * The iterator (below) only uses pivot, min_size and stats.
+ */
+struct clique_options {
+	unsigned             threads;    /* as for graph_iterate_maximal_cliques_parallel() */
+	bool                 serialize;
+	enum clique_pivot    pivot;
+	uint32_t             min_size;
+	struct clique_stats  *stats;     /* if non-NULL, receives statistics */
+
+	double               max_seconds;
+	uint64_t             max_calls;
+	uint64_t             max_cliques;
+
+	double               progress_interval;
+	void                 (*progress)(const struct clique_progress *p, void *ctx);
+	void                 *progress_ctx;
+
+	struct clique_position resume;
+};
+
+/*
+ * The general version of the above. ctxs is used as for
+ * graph_iterate_maximal_cliques_parallel(); when running in a single
+ * thread, only ctxs[0] is used.
+ */
+int
+graph_iterate_maximal_cliques_opt(const struct Graph *gra, const struct clique_options *opt,
+				  int (*cb)(const struct Node **nodes, size_t count, void *ctx), void **ctxs);
+
+
+/*
+ * Count the maximal cliques by size, without reporting them. opt is
+ * used as for graph_iterate_maximal_cliques_opt() (serialize is
+ * ignored) and may be NULL. With several threads, each one keeps its
+ * own counts, which are summed at the end.
+ *
+ * On success, by_size[s] is the number of maximal cliques with s
+ * nodes, for s = 0..max_size; it is malloc()ed, and the caller must
+ * free() it. Returns 0 on success, -1 on failure. If a budget runs
+ * out (errno ETIMEDOUT), the counts so far are still filled in.
+ */
+struct clique_counts {
+	uint64_t  total;
+	uint32_t  max_size;
+	uint64_t  *by_size;
+};
+
+int
+graph_count_maximal_cliques(const struct Graph *gra, const struct clique_options *opt, struct clique_counts *counts);
+
+
+/*
+ * Pull-style enumeration: Instead of having a callback called for
+ * each maximal clique, create an iterator with clique_iter_begin(),
+ * and get the cliques one at a time with clique_iter_next(). The
+ * search is suspended in between, so the caller may stop at any
+ * time, or interleave the enumeration with other work. The iterator
+ * runs in the calling thread; threads and serialize in opt are
+ * ignored, and opt may be NULL. If opt->stats is set, it is filled in
+ * by clique_iter_end().
+ *
+ * clique_iter_begin() treats the graph as
+ * graph_iterate_maximal_cliques() does, and returns NULL on failure.
+ *
+ * clique_iter_next() returns the number of nodes of the next maximal
+ * clique and points *nodes at them; the array is only valid until the
+ * next call. It returns 0 when there are no more cliques, and -1 on
+ * allocation failure.
+ *
+ * clique_iter_end() releases the iterator, whether or not all
+ * cliques have been retrieved.
+ */
+struct clique_iter;
+
+struct clique_iter *
+clique_iter_begin(const struct Graph *gra, const struct clique_options *opt);
+
+ssize_t
+clique_iter_next(struct clique_iter *it, const struct Node ***nodes);
+
+void
+clique_iter_end(struct clique_iter *it);
 
 #endif /* !CLIQUE_H_INCLUDED */
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "graph.h"
+#include "frozen.h"
+#include "core.h"
+
+int64_t
+frozen_core_numbers(const struct FrozenGraph *fg, uint32_t *core, uint32_t *order)
+{
+	uint32_t n = fg->node_count;
+	size_t nn = n ? n : 1;
+	uint32_t *deg = core;  /* the remaining degrees end up as the core numbers */
+	uint32_t *vert = order ? order : malloc(nn * sizeof(*vert));
+	uint32_t *pos = malloc(nn * sizeof(*pos));
+	uint32_t *bin = NULL;
+	uint32_t maxdeg = 0, degeneracy = 0;
+
+	if (!(fg->flags & FROZEN_SYMMETRIC)) {
+		errno = EINVAL;
+		goto fail;
+	}
+	if (vert == NULL || pos == NULL)
+		goto nomem;
+
+	for (uint32_t v = 0; v < n; ++v) {
+		deg[v] = frozen_degree(fg, v);
+		if (deg[v] > maxdeg)
+			maxdeg = deg[v];
+	}
+	bin = calloc((size_t)maxdeg + 1, sizeof(*bin));
+	if (bin == NULL)
+		goto nomem;
+
+	/* Counting sort by degree; bin[d] becomes the start of the nodes with degree d. */
+	for (uint32_t v = 0; v < n; ++v)
+		bin[deg[v]]++;
+	for (uint32_t d = 0, start = 0; d <= maxdeg; ++d) {
+		uint32_t num = bin[d];
+		bin[d] = start;
+		start += num;
+	}
+	for (uint32_t v = 0; v < n; ++v) {
+		pos[v] = bin[deg[v]]++;
+		vert[pos[v]] = v;
+	}
+	for (uint32_t d = maxdeg; d > 0; --d)
+		bin[d] = bin[d-1];
+	bin[0] = 0;
+
+	for (uint32_t i = 0; i < n; ++i) {
+		uint32_t v = vert[i];
+
+		if (deg[v] > degeneracy)
+			degeneracy = deg[v];
+		for (uint64_t k = fg->offset[v]; k < fg->offset[v+1]; ++k) {
+			uint32_t u = fg->adj[k];
+			if (deg[u] > deg[v]) {
+				/* Move u to the start of its bin, and shift the bin boundary past it. */
+				uint32_t du = deg[u], pu = pos[u];
+				uint32_t pw = bin[du], w = vert[pw];
+				if (u != w) {
+					pos[u] = pw;
+					vert[pu] = w;
+					pos[w] = pu;
+					vert[pw] = u;
+				}
+				bin[du]++;
+				deg[u]--;
+			}
+		}
+	}
+
+	free(bin);
+	free(pos);
+	if (!order)
+		free(vert);
+	return degeneracy;
+
+nomem:
+	errno = ENOMEM;
+fail:
+	free(pos);
+	if (!order)
+		free(vert);
+	return -1;
+}
+
+int64_t
+graph_core_numbers(const struct Graph *g, uint32_t *core)
+{
+	struct FrozenGraph fg;
+	int64_t ret;
+
+	if (graph_freeze(g, &fg, FROZEN_SYMMETRIC))
+		return -1;
+	/* Freshly frozen, so frozen node i is the graph node with ->index i. */
+	ret = frozen_core_numbers(&fg, core, NULL);
+	frozen_destroy(&fg);
+	return ret;
+}
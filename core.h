@@ -0,0 +1,46 @@
+#ifndef CORE_H_INCLUDED
+#define CORE_H_INCLUDED
+
+#include <stdint.h>
+
+#include "graph.h"
+#include "frozen.h"
+
+/*
+ * The k-core of a graph is the largest subgraph in which every node
+ * has degree at least k; the core number of a node is the largest k
+ * for which it belongs to the k-core. Direction, loops and parallel
+ * edges are ignored.
+ *
+ * The core numbers are computed with the O(m) bucket algorithm of
+ * Batagelj and Zaversnik: Repeatedly remove a node of minimum
+ * remaining degree, keeping the nodes sorted by remaining degree in
+ * an array with bucket boundaries, so that decrementing a neighbour's
+ * degree is a constant time swap. The order of removal is a
+ * degeneracy order: every node has at most (max core number)
+ * neighbours later in the order.
+ */
+
+/**
+ * frozen_core_numbers - compute core numbers of a frozen graph
+ *
+ * @fg: A frozen graph created with FROZEN_SYMMETRIC
+ * @core: Array of fg->node_count entries receiving the core numbers
+ * @order: If non-NULL, array of fg->node_count entries receiving the
+ *         nodes in degeneracy order
+ *
+ * Returns: The degeneracy (maximal core number), or -1 on failure.
+ */
+int64_t frozen_core_numbers(const struct FrozenGraph *fg, uint32_t *core, uint32_t *order);
+
+/**
+ * graph_core_numbers - compute core numbers of a graph
+ *
+ * @core: Array of g->node_count entries; core[node->index] receives
+ *        the core number of node.
+ *
+ * Returns: The degeneracy, or -1 on failure.
+ */
+int64_t graph_core_numbers(const struct Graph *g, uint32_t *core);
+
+#endif /* !CORE_H_INCLUDED */
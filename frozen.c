@@ -0,0 +1,420 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/queue.h>
+
+#include "graph.h"
+#include "frozen.h"
+
+/*
+ * Building the snapshot is a two-pass affair: First count the
+ * degrees (which gives us the offsets by a prefix sum), then fill in
+ * the adjacency lists. For a symmetric snapshot, every edge
+ * contributes to both endpoints, and after sorting each adjacency
+ * list we squeeze out duplicates (parallel edges, or an edge which
+ * was added in both directions, e.g. with GRAPH_DUAL).
+ *
+ * The nodes keep the numbers they got from the graph (order of
+ * creation), which means that fg->pos starts out as the identity.
+ */
+
+static int
+cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void
+sort_u32(uint32_t *a, uint64_t n)
+{
+	if (n > 16) {
+		qsort(a, n, sizeof(*a), cmp_u32);
+		return;
+	}
+	for (uint64_t i = 1; i < n; ++i) {
+		uint32_t x = a[i];
+		uint64_t j = i;
+		while (j > 0 && a[j-1] > x) {
+			a[j] = a[j-1];
+			j--;
+		}
+		a[j] = x;
+	}
+}
+
+void
+frozen_destroy(struct FrozenGraph *fg)
+{
+	free(fg->offset);
+	free(fg->adj);
+	free(fg->nodes);
+	free(fg->comp);
+	free(fg->pos);
+	memset(fg, 0, sizeof(*fg));
+}
+
+#define LOCAL(map, node) ((map) ? (map)[(node)->index] : (node)->index)
+
+/*
+ * Fill in offset and adj, given node_count, flags and nodes. If map
+ * is non-NULL, it gives the frozen node number of every graph node
+ * by ->index; otherwise, the frozen numbers are the ->index values.
+ */
+static int
+freeze_edges(struct FrozenGraph *fg, const uint32_t *map)
+{
+	const struct Edge *e;
+	uint32_t n = fg->node_count;
+	bool sym = fg->flags & FROZEN_SYMMETRIC;
+	uint64_t *fill;
+
+	fg->offset = calloc((size_t)n + 1, sizeof(*fg->offset));
+	if (!fg->offset)
+		return -1;
+	for (uint32_t i = 0; i < n; ++i) {
+		SLIST_FOREACH(e, &fg->nodes[i]->out_edges, nodelink) {
+			if (!sym) {
+				fg->offset[i+1]++;
+			} else if (e->tgt != fg->nodes[i]) {
+				fg->offset[i+1]++;
+				fg->offset[LOCAL(map, e->tgt)+1]++;
+			}
+		}
+	}
+	for (uint32_t i = 0; i < n; ++i)
+		fg->offset[i+1] += fg->offset[i];
+	fg->adj_count = fg->offset[n];
+
+	fg->adj = malloc((fg->adj_count ? fg->adj_count : 1) * sizeof(*fg->adj));
+	fill = malloc((n ? n : 1) * sizeof(*fill));
+	if (!fg->adj || !fill) {
+		free(fill);
+		return -1;
+	}
+	memcpy(fill, fg->offset, n * sizeof(*fill));
+
+	for (uint32_t i = 0; i < n; ++i) {
+		SLIST_FOREACH(e, &fg->nodes[i]->out_edges, nodelink) {
+			uint32_t t = LOCAL(map, e->tgt);
+			if (!sym) {
+				fg->adj[fill[i]++] = t;
+			} else if (t != i) {
+				fg->adj[fill[i]++] = t;
+				fg->adj[fill[t]++] = i;
+			}
+		}
+	}
+	free(fill);
+
+	if (!sym) {
+		for (uint32_t i = 0; i < n; ++i)
+			sort_u32(fg->adj + fg->offset[i], frozen_degree(fg, i));
+		return 0;
+	}
+
+	/* Sort, and compact away duplicates. */
+	uint64_t w = 0, start = 0;
+	for (uint32_t i = 0; i < n; ++i) {
+		uint64_t end = fg->offset[i+1];
+		sort_u32(fg->adj + start, end - start);
+		fg->offset[i] = w;
+		for (uint64_t k = start; k < end; ++k) {
+			if (k == start || fg->adj[k] != fg->adj[k-1])
+				fg->adj[w++] = fg->adj[k];
+		}
+		start = end;
+	}
+	fg->offset[n] = w;
+	if (w < fg->adj_count) {
+		uint32_t *shrunk = realloc(fg->adj, (w ? w : 1) * sizeof(*fg->adj));
+		if (shrunk)
+			fg->adj = shrunk;
+		fg->adj_count = w;
+	}
+	return 0;
+}
+#undef LOCAL
+
+int
+graph_freeze(const struct Graph *g, struct FrozenGraph *fg, unsigned flags)
+{
+	const struct Component *c;
+	const struct Node *node;
+	uint32_t n = g->node_count;
+	uint32_t cidx = 0;
+
+	memset(fg, 0, sizeof(*fg));
+	if (flags & ~FROZEN_SYMMETRIC) {
+		errno = EINVAL;
+		return -1;
+	}
+	fg->node_count = n;
+	fg->flags = flags;
+	fg->nodes = malloc((n ? n : 1) * sizeof(*fg->nodes));
+	fg->comp = malloc((n ? n : 1) * sizeof(*fg->comp));
+	fg->pos = malloc((n ? n : 1) * sizeof(*fg->pos));
+	if (!fg->nodes || !fg->comp || !fg->pos)
+		goto fail;
+
+	TAILQ_FOREACH(c, &g->components, list) {
+		STAILQ_FOREACH(node, &c->nodes, complink) {
+			uint32_t i = node->index;
+			assert(i < n);
+			fg->nodes[i] = node;
+			fg->comp[i] = cidx;
+			fg->pos[i] = i;
+		}
+		cidx++;
+	}
+	fg->comp_count = cidx;
+
+	if (freeze_edges(fg, NULL))
+		goto fail;
+	return 0;
+
+fail:
+	frozen_destroy(fg);
+	errno = ENOMEM;
+	return -1;
+}
+
+int
+component_freeze(const struct Component *comp, struct FrozenGraph *fg, unsigned flags, uint32_t *scratch)
+{
+	const struct Node *node;
+	uint32_t *map = scratch;
+	uint32_t n = comp->node_count;
+	uint32_t i = 0;
+
+	memset(fg, 0, sizeof(*fg));
+	if (flags & ~FROZEN_SYMMETRIC) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (map == NULL) {
+		uint32_t max = 0;
+		STAILQ_FOREACH(node, &comp->nodes, complink) {
+			if (node->index > max)
+				max = node->index;
+		}
+		map = malloc(((size_t)max + 1) * sizeof(*map));
+		if (map == NULL)
+			goto fail;
+	}
+	fg->node_count = n;
+	fg->comp_count = 1;
+	fg->flags = flags;
+	fg->nodes = malloc((n ? n : 1) * sizeof(*fg->nodes));
+	if (!fg->nodes)
+		goto fail;
+	STAILQ_FOREACH(node, &comp->nodes, complink) {
+		fg->nodes[i] = node;
+		map[node->index] = i++;
+	}
+	assert(i == n);
+
+	if (freeze_edges(fg, map))
+		goto fail;
+	if (map != scratch)
+		free(map);
+	return 0;
+
+fail:
+	if (map != scratch)
+		free(map);
+	frozen_destroy(fg);
+	errno = ENOMEM;
+	return -1;
+}
+
+int
+frozen_permute(struct FrozenGraph *fg, const uint32_t *perm)
+{
+	uint32_t n = fg->node_count;
+	size_t nn = n ? n : 1;
+	uint64_t *offset = malloc(((size_t)n + 1) * sizeof(*offset));
+	uint32_t *adj = malloc((fg->adj_count ? fg->adj_count : 1) * sizeof(*adj));
+	const struct Node **nodes = malloc(nn * sizeof(*nodes));
+	uint32_t *comp = fg->comp ? malloc(nn * sizeof(*comp)) : NULL;
+	uint32_t *inv = malloc(nn * sizeof(*inv));
+
+	if (!offset || !adj || !nodes || (fg->comp && !comp) || !inv) {
+		free(offset);
+		free(adj);
+		free(nodes);
+		free(comp);
+		free(inv);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < n; ++i) {
+		inv[perm[i]] = i;
+		nodes[perm[i]] = fg->nodes[i];
+		if (comp)
+			comp[perm[i]] = fg->comp[i];
+	}
+	offset[0] = 0;
+	for (uint32_t j = 0; j < n; ++j) {
+		uint32_t o = inv[j];
+		const uint32_t *src = fg->adj + fg->offset[o];
+		uint32_t *dst = adj + offset[j];
+		uint64_t d = frozen_degree(fg, o);
+
+		for (uint64_t k = 0; k < d; ++k)
+			dst[k] = perm[src[k]];
+		sort_u32(dst, d);
+		offset[j+1] = offset[j] + d;
+	}
+	for (uint32_t i = 0; fg->pos && i < n; ++i)
+		fg->pos[i] = perm[fg->pos[i]];
+
+	free(inv);
+	free(fg->offset);
+	free(fg->adj);
+	free(fg->nodes);
+	free(fg->comp);
+	fg->offset = offset;
+	fg->adj = adj;
+	fg->nodes = nodes;
+	fg->comp = comp;
+	return 0;
+}
+
+/* Order by degree, breaking ties by current number to make the result deterministic. */
+static int
+cmp_degree_asc(const void *a, const void *b, void *ctx)
+{
+	const struct FrozenGraph *fg = ctx;
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	uint64_t dx = frozen_degree(fg, x), dy = frozen_degree(fg, y);
+	if (dx != dy)
+		return dx < dy ? -1 : 1;
+	return (x > y) - (x < y);
+}
+static int
+cmp_degree_desc(const void *a, const void *b, void *ctx)
+{
+	const struct FrozenGraph *fg = ctx;
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	uint64_t dx = frozen_degree(fg, x), dy = frozen_degree(fg, y);
+	if (dx != dy)
+		return dx > dy ? -1 : 1;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Cuthill-McKee: Repeatedly pick the unvisited node of smallest
+ * degree, and do a breadth first search from it, enqueueing the
+ * unvisited neighbours of each node in order of increasing
+ * degree. The queue is the order.
+ */
+static void
+order_bfs(struct FrozenGraph *fg, uint32_t *order, uint32_t *bydeg, unsigned char *seen)
+{
+	uint32_t n = fg->node_count;
+	uint32_t head = 0, tail = 0;
+
+	for (uint32_t i = 0; i < n; ++i)
+		bydeg[i] = i;
+	qsort_r(bydeg, n, sizeof(*bydeg), cmp_degree_asc, fg);
+
+	for (uint32_t s = 0; s < n; ++s) {
+		if (seen[bydeg[s]])
+			continue;
+		seen[bydeg[s]] = 1;
+		order[tail++] = bydeg[s];
+		while (head < tail) {
+			uint32_t u = order[head++];
+			uint32_t first = tail;
+			for (uint64_t k = fg->offset[u]; k < fg->offset[u+1]; ++k) {
+				uint32_t v = fg->adj[k];
+				if (!seen[v]) {
+					seen[v] = 1;
+					order[tail++] = v;
+				}
+			}
+			qsort_r(order + first, tail - first, sizeof(*order), cmp_degree_asc, fg);
+		}
+	}
+	assert(tail == n);
+}
+
+static void
+order_component(struct FrozenGraph *fg, uint32_t *order, uint32_t *count)
+{
+	uint32_t n = fg->node_count;
+
+	/* A stable counting sort by component number. */
+	if (fg->comp == NULL) {
+		for (uint32_t i = 0; i < n; ++i)
+			order[i] = i;
+		return;
+	}
+	memset(count, 0, ((size_t)fg->comp_count + 1) * sizeof(*count));
+	for (uint32_t i = 0; i < n; ++i)
+		count[fg->comp[i] + 1]++;
+	for (uint32_t c = 0; c < fg->comp_count; ++c)
+		count[c+1] += count[c];
+	for (uint32_t i = 0; i < n; ++i)
+		order[count[fg->comp[i]]++] = i;
+}
+
+int
+frozen_reorder(struct FrozenGraph *fg, enum frozen_order how)
+{
+	uint32_t n = fg->node_count;
+	size_t nn = n ? n : 1;
+	uint32_t *order = malloc(nn * sizeof(*order));
+	uint32_t *tmp = NULL;
+	unsigned char *seen = NULL;
+	int ret = -1;
+
+	if (!order)
+		goto out;
+
+	switch (how) {
+	case FROZEN_ORDER_DEGREE:
+		for (uint32_t i = 0; i < n; ++i)
+			order[i] = i;
+		qsort_r(order, n, sizeof(*order), cmp_degree_desc, fg);
+		break;
+	case FROZEN_ORDER_BFS:
+		tmp = malloc(nn * sizeof(*tmp));
+		seen = calloc(nn, 1);
+		if (!tmp || !seen)
+			goto out;
+		order_bfs(fg, order, tmp, seen);
+		break;
+	case FROZEN_ORDER_COMPONENT:
+		tmp = malloc(((size_t)fg->comp_count + 1) * sizeof(*tmp));
+		if (!tmp)
+			goto out;
+		order_component(fg, order, tmp);
+		break;
+	default:
+		errno = EINVAL;
+		goto out;
+	}
+
+	/* order[k] is the node which should get number k; we need the inverse. */
+	free(tmp);
+	tmp = malloc(nn * sizeof(*tmp));
+	if (!tmp)
+		goto out;
+	for (uint32_t k = 0; k < n; ++k)
+		tmp[order[k]] = k;
+	ret = frozen_permute(fg, tmp);
+
+out:
+	if (ret && errno != EINVAL)
+		errno = ENOMEM;
+	free(order);
+	free(tmp);
+	free(seen);
+	return ret;
+}
@@ -0,0 +1,117 @@
+#ifndef FROZEN_H_INCLUDED
+#define FROZEN_H_INCLUDED
+
+#include <stdint.h>
+
+#include "graph.h"
+
+/*
+ * A frozen graph is a read-only snapshot of a struct Graph in
+ * compressed sparse row form: the nodes are numbered 0..node_count-1,
+ * and the neighbours of node i are adj[offset[i]] ... adj[offset[i+1]-1],
+ * sorted in increasing order. This is much more compact than the
+ * linked lists of struct Graph, and traversals run through
+ * contiguous memory. The snapshot does not change if more nodes or
+ * edges are subsequently added to the graph, but it refers to the
+ * graph's nodes, so the graph must outlive it.
+ */
+
+#define FROZEN_SYMMETRIC 0x01 /* store each edge in both directions, ignoring loops and parallel edges */
+
+struct FrozenGraph {
+	uint32_t           node_count;
+	uint32_t           comp_count;
+	uint64_t           adj_count;  /* == offset[node_count] */
+	unsigned           flags;
+
+	uint64_t           *offset;    /* node_count+1 entries */
+	uint32_t           *adj;       /* adj_count entries */
+	const struct Node  **nodes;    /* the graph node corresponding to each frozen node */
+	uint32_t           *comp;      /* component number, in graph_iterate_components() order */
+	uint32_t           *pos;       /* frozen node number of the graph node with ->index i */
+};
+
+static inline uint32_t
+frozen_degree(const struct FrozenGraph *fg, uint32_t i)
+{
+	return fg->offset[i+1] - fg->offset[i];
+}
+
+/* The frozen node number of a node of the underlying graph. */
+static inline uint32_t
+frozen_node(const struct FrozenGraph *fg, const struct Node *node)
+{
+	return fg->pos[node->index];
+}
+
+/**
+ * graph_freeze - take a snapshot of a graph
+ *
+ * @g: The graph
+ * @fg: The struct FrozenGraph to initialize
+ * @flags: Bitwise OR of FROZEN_* macros
+ *
+ * Initially, nodes are numbered in order of creation, so that
+ * fg->nodes[i]->index == i. Without FROZEN_SYMMETRIC, node i has the
+ * targets of its outgoing edges as neighbours, including any loops
+ * and parallel edges.
+ *
+ * Returns: 0 on success, -1 on failure (with errno set).
+ */
+int graph_freeze(const struct Graph *g, struct FrozenGraph *fg, unsigned flags);
+
+/**
+ * component_freeze - take a snapshot of a single component
+ *
+ * @scratch: If non-NULL, an array with at least one entry for every
+ *           node ->index in @comp, whose contents are overwritten;
+ *           otherwise, such an array is allocated internally.
+ *
+ * Like graph_freeze(), but the nodes of @comp are numbered
+ * 0..comp->node_count-1 in the order of the component's node
+ * list. The fields comp and pos are NULL, so frozen_node() cannot be
+ * used; fg->nodes maps the other way. Callers snapshotting many
+ * components should pass @scratch to avoid a pass over the component
+ * and an allocation proportional to the largest ->index.
+ *
+ * Returns: 0 on success, -1 on failure (with errno set).
+ */
+int component_freeze(const struct Component *comp, struct FrozenGraph *fg, unsigned flags, uint32_t *scratch);
+
+/* Free the memory used by a frozen graph. */
+void frozen_destroy(struct FrozenGraph *fg);
+
+
+enum frozen_order {
+	FROZEN_ORDER_DEGREE,    /* by decreasing degree */
+	FROZEN_ORDER_BFS,       /* Cuthill-McKee: breadth first, low degree neighbours first */
+	FROZEN_ORDER_COMPONENT, /* components contiguously, in graph order */
+};
+
+/**
+ * frozen_reorder - renumber the nodes of a frozen graph
+ *
+ * The nodes of a graph are laid out in the order they first appear
+ * in the input, so the neighbours of a node are usually scattered
+ * all over. Renumbering the nodes such that neighbours get nearby
+ * numbers makes traversals over the frozen graph touch memory in a
+ * much more sequential manner. All arrays in @fg are permuted
+ * accordingly, and adjacency lists are kept sorted.
+ *
+ * Returns: 0 on success, -1 on failure (in which case @fg is unchanged).
+ */
+int frozen_reorder(struct FrozenGraph *fg, enum frozen_order order);
+
+/**
+ * frozen_permute - renumber the nodes of a frozen graph
+ *
+ * @perm: A permutation of 0..node_count-1; node i becomes node perm[i].
+ *
+ * This is what frozen_reorder() uses; it is exposed for callers
+ * having their own idea of a good order.
+ *
+ * Returns: 0 on success, -1 on failure (in which case @fg is unchanged).
+ */
+int frozen_permute(struct FrozenGraph *fg, const uint32_t *perm);
+
+#endif /* !FROZEN_H_INCLUDED */
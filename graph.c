@@ -2,14 +2,19 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
-#include <obstack.h>
 #include <assert.h>
-#include <error.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "graph.h"
 #include "jenkins_hash.h"
+#include "arena.h"
 
 /* <sys/queue.h> on most Linux systems seem to lack this. */
 #ifndef TAILQ_FOREACH_SAFE
@@ -45,14 +50,16 @@
  * Graph also contains a hash table consisting of the set of nodes in
  * the graph. A graph can be undirected, which we implement by forcing
  * edges to be oriented canonically (see below). Finally, a Graph
- * contains two obstacks for handling the memory bookkeeping for nodes
- * and edges. This detail has two nice consequences: First, malloc
- * overhead is essentially eliminated, which means that edges only
- * take up half the space they otherwise would (glibc's smallest
- * allocatable chunk is 24 bytes + 8 bytes overhead). Second, we
- * cannot possibly leak any memory; all the memory ever allocated to a
- * graph is easily accessible and freeable from the struct Graph
- * itself.
+ * contains two arenas (see arena.h) for handling the memory
+ * bookkeeping for nodes and edges. This detail has three nice
+ * consequences: First, malloc overhead is essentially eliminated,
+ * which means that edges only take up half the space they otherwise
+ * would (glibc's smallest allocatable chunk is 24 bytes + 8 bytes
+ * overhead). Second, we cannot possibly leak any memory; all the
+ * memory ever allocated to a graph is easily accessible and freeable
+ * from the struct Graph itself. Third, the arenas are backed by huge
+ * pages where possible, which greatly reduces TLB pressure when
+ * chasing pointers through a graph of many gigabytes.
  *
  * A Component contains the bookkeeping field chaining the components
  * together in the Graph's tail queue. It also heads a singly-linked
@@ -66,7 +73,11 @@
  * of Nodes, and the singly-linked tail queue of nodes belonging to a
  * particular component. A node also heads a singly-linked list of
  * edges having that node as source, and contains counters for
- * in-degree and out-degree.
+ * in-degree and out-degree. Finally, nodes are numbered
+ * consecutively in order of creation; since we only ever undo adding
+ * the most recently created node, the numbers are always exactly
+ * 0..node_count-1, which makes it cheap to build arrays indexed by
+ * node (see frozen.c).
  *
  * An Edge is the simplest of the data structures. It simply contains
  * a pointer to its target, and a bookkeeping field for being inserted
@@ -78,25 +89,43 @@
  */
 
 /*
- * At some point, I should steal the obstack implementation and make a
- * version which does not require the underlying allocator to succeed
- * or abort. I'd also like to get rid of some of the compatibility
- * crap.
+ * Load statistics. Phase timings are taken in "ticks", which is the
+ * TSC where we have it and nanoseconds otherwise. They are converted
+ * to seconds when printed, by comparing the tick count to the wall
+ * clock elapsed since graph_loadstats_init().
  */
+static inline uint64_t
+loadstats_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
 
+#define LOADSTATS_BEGIN(g, t0)						\
+	uint64_t t0 = (g)->loadstats ? loadstats_ticks() : 0
+#define LOADSTATS_END(g, t0, field) do {				\
+		if ((g)->loadstats)					\
+			(g)->loadstats->field += loadstats_ticks() - (t0); \
+	} while (0)
 
-#define obstack_chunk_alloc  xmalloc
-#define obstack_chunk_free   free
+static inline void
+loadstats_edges_added(struct Graph *g, uint64_t t0, unsigned count)
+{
+	if (g->loadstats) {
+		g->loadstats->t_edge += loadstats_ticks() - t0;
+		g->loadstats->edges += count;
+	}
+}
 
-static void*
-xmalloc(size_t s)
+static double
+timespec_diff(const struct timespec *a, const struct timespec *b)
 {
-	void *p = malloc(s);
-	if (p != NULL)
-		return p;
-  
-	error(2, errno, "malloc()");
-	abort(); 
+	return (double)(a->tv_sec - b->tv_sec) + 1e-9 * (a->tv_nsec - b->tv_nsec);
 }
 
 /* Small convenient node methods. */
@@ -136,6 +165,7 @@ static struct Component*
 graph_merge_components(struct Graph *g, struct Component *c1, struct Component *c2)
 {
 	struct Node *n;
+	LOADSTATS_BEGIN(g, t0);
 
 	assert(c1 != c2);
 
@@ -163,6 +193,7 @@ graph_merge_components(struct Graph *g, struct Component *c1, struct Component *
 	c2->node_count = c2->edge_count = 0;
 	/* Remove the now empty component */
 	graph_remove_component(g, c2);
+	LOADSTATS_END(g, t0, t_merge);
 	return c1;
 }
 
@@ -222,9 +253,10 @@ graph_attempt_hash_resize(struct Graph *g)
 static struct Node*
 graph_alloc_node(struct Graph *g, size_t len)
 {
-	struct Node *n = obstack_alloc(&g->node_os, sizeof(*n) + len + 1);
+	struct Node *n = arena_alloc(&g->node_arena, sizeof(*n) + len + 1);
 	if (!n)
 		return NULL;
+	n->index = g->node_count;
 	if (++g->node_count > g->resize_threshold)
 		graph_attempt_hash_resize(g);
 	return n;
@@ -233,7 +265,7 @@ graph_alloc_node(struct Graph *g, size_t len)
 /*
  * If some allocation fails, we need to undo adding nodes. This means
  * removing it from the graph's hash table, and deallocating it from
- * the top of the obstack. This can only be done for the most recently
+ * the top of the arena. This can only be done for the most recently
  * added node. The node must have been added to the graph's hash
  * table, but must not have been assigned to any component.
  */
@@ -252,7 +284,7 @@ graph_remove_last_node(struct Graph *g, struct Node *n)
 	 * front, and defers to SLIST_REMOVE_HEAD in the common case.
 	 */
 	SLIST_REMOVE(&g->nodes[g->hashmask & n->hv], n, Node, hashlink);
-	obstack_free(&g->node_os, n);
+	arena_free(&g->node_arena, n);
 	g->node_count--;
 }
 
@@ -269,24 +301,27 @@ graph_remove_last_node(struct Graph *g, struct Node *n)
  * immediately merging them, or when we are adding an edge with one
  * endpoint in an existing component, so that we know that the new
  * node will belong to that component).
+ *
+ * graph_add_node_hashed() is for callers which already know the
+ * length and hash value of the identifier (graph_merge()).
  */
 static struct Node*
-graph_add_node_internal(struct Graph *g, const char *nstr, int create_comp)
+graph_add_node_hashed(struct Graph *g, const char *nstr, size_t idlen, uint32_t hv, int create_comp)
 {
 	struct Node *n;
 	struct Component *c;
-	size_t idlen;
-	uint32_t hv;
+	LOADSTATS_BEGIN(g, t0);
 
-	idlen = strlen(nstr);
-#define HASH_INIT   0xC0FFEE
-	hv = jenkins_hash(nstr, idlen, HASH_INIT);
 	SLIST_FOREACH(n, &g->nodes[g->hashmask & hv], hashlink) {
-		if (hv == n->hv && strcmp(nstr, n->ident) == 0)
+		if (hv == n->hv && strcmp(nstr, n->ident) == 0) {
+			LOADSTATS_END(g, t0, t_hash);
 			return n;
+		}
 	}
+	LOADSTATS_END(g, t0, t_hash);
 
 	/* No node with that name exists. Create one. */
+	LOADSTATS_BEGIN(g, t1);
 	n = graph_alloc_node(g, idlen);
 	if (n == NULL)
 		return NULL;
@@ -307,10 +342,25 @@ graph_add_node_internal(struct Graph *g, const char *nstr, int create_comp)
 		}
 		component_add_node(c, n);
 	}
+	LOADSTATS_END(g, t1, t_alloc);
 
 	return n;
 }
 
+static struct Node*
+graph_add_node_internal(struct Graph *g, const char *nstr, int create_comp)
+{
+	size_t idlen;
+	uint32_t hv;
+	LOADSTATS_BEGIN(g, t0);
+
+	idlen = strlen(nstr);
+#define HASH_INIT   0xC0FFEE
+	hv = jenkins_hash(nstr, idlen, HASH_INIT);
+	LOADSTATS_END(g, t0, t_hash);
+	return graph_add_node_hashed(g, nstr, idlen, hv, create_comp);
+}
+
 /**
  * Public interfaces.
  */
@@ -382,6 +432,73 @@ component_iterate_edges(const struct Component *comp, int (*cb)(const struct Nod
 	return 0;
 }
 
+/*
+ * Fill up the batch with the edges of comp, flushing it to the
+ * callback whenever it is full. The caller flushes the final partial
+ * batch.
+ */
+static int
+component_fill_edge_batches(const struct Component *comp, struct EdgePair *batch, size_t *count,
+			    int (*cb)(const struct EdgePair *edges, size_t count, void *ctx), void *ctx)
+{
+	const struct Node *src;
+	const struct Edge *edge;
+	size_t n = *count;
+
+	GRAPH_FOREACH_COMPONENT_EDGE(src, edge, comp) {
+		batch[n].src = src;
+		batch[n].tgt = edge->tgt;
+		if (++n == GRAPH_EDGE_BATCH) {
+			int r = cb(batch, n, ctx);
+			if (r)
+				return r;
+			n = 0;
+		}
+	}
+	*count = n;
+	return 0;
+}
+
+int
+component_iterate_edge_batches(const struct Component *comp, int (*cb)(const struct EdgePair *edges, size_t count, void *ctx), void *ctx)
+{
+	struct EdgePair batch[GRAPH_EDGE_BATCH];
+	size_t count = 0;
+	int r;
+
+	r = component_fill_edge_batches(comp, batch, &count, cb, ctx);
+	if (r)
+		return r;
+	return count ? cb(batch, count, ctx) : 0;
+}
+
+int
+graph_iterate_edge_batches(const struct Graph *g, int (*cb)(const struct EdgePair *edges, size_t count, void *ctx), void *ctx)
+{
+	struct EdgePair batch[GRAPH_EDGE_BATCH];
+	const struct Component *comp;
+	size_t count = 0;
+
+	GRAPH_FOREACH_COMPONENT(comp, g) {
+		int r = component_fill_edge_batches(comp, batch, &count, cb, ctx);
+		if (r)
+			return r;
+	}
+	return count ? cb(batch, count, ctx) : 0;
+}
+
+const struct Node *
+graph_find_node(const struct Graph *g, const char *ident)
+{
+	const struct Node *n;
+	uint32_t hv = jenkins_hash(ident, strlen(ident), HASH_INIT);
+
+	SLIST_FOREACH(n, &g->nodes[g->hashmask & hv], hashlink) {
+		if (hv == n->hv && strcmp(ident, n->ident) == 0)
+			return n;
+	}
+	return NULL;
+}
 
 bool
 graph_edge_exists(const struct Node *src, const struct Node *tgt)
@@ -431,10 +548,11 @@ graph_init(struct Graph *g, unsigned flags)
 		SLIST_INIT(&g->nodes[i]);
 	}
 
-	obstack_begin(&g->node_os, 1 << 11);
-	obstack_begin(&g->edge_os, 1 << 11);
+	arena_init(&g->node_arena);
+	arena_init(&g->edge_arena);
   
 	g->flags = flags;
+	g->loadstats = NULL;
 
 	return 0;
 }
@@ -446,8 +564,8 @@ graph_destroy(struct Graph *g)
 		free(c);
 	}
 	free(g->nodes);
-	obstack_free(&g->node_os, NULL);
-	obstack_free(&g->edge_os, NULL);
+	arena_destroy(&g->node_arena);
+	arena_destroy(&g->edge_arena);
 	memset(g, 0, sizeof(*g));
 }
 
@@ -481,7 +599,7 @@ do_add_edge(struct Graph *g, struct Node *src, struct Node *tgt)
 	 */
 	struct Edge *e;
 
-	e = obstack_alloc(&g->edge_os, sizeof(*e));
+	e = arena_alloc(&g->edge_arena, sizeof(*e));
 	if (!e)
 		return -1;
 	/* e->src = src; */
@@ -502,7 +620,7 @@ do_add_edge(struct Graph *g, struct Node *src, struct Node *tgt)
 		   to update their ->comp fields (component_add_node() does this). */
 		struct Component *c = graph_new_component(g);
 		if (c == NULL) {
-			obstack_free(&g->edge_os, e);
+			arena_free(&g->edge_arena, e);
 			return -1;
 		}
 
@@ -548,22 +666,16 @@ do_add_edge(struct Graph *g, struct Node *src, struct Node *tgt)
  
 }
 
-int
-graph_add_edge(struct Graph *g, const char *s1, const char *s2)
+/*
+ * Connect two nodes returned by graph_add_node_internal(g, ..., 0),
+ * in that order, respecting the graph's flags. If an error occurs,
+ * nodes which were newly created are removed again.
+ */
+static int
+graph_add_edge_nodes(struct Graph *g, struct Node *n1, struct Node *n2)
 {
-	struct Node *n1, *n2;
 	int swapped = 0;
 
-	n1 = graph_add_node_internal(g, s1, 0);
-	if (n1 == NULL)
-		return -1;
-	n2 = graph_add_node_internal(g, s2, 0);
-	if (n2 == NULL) {
-		if (n1->comp == NULL)
-			graph_remove_last_node(g, n1);
-		return -1;
-	}
-
 	if ((g->flags & GRAPH_UNDIRECTED) && nodes_cmp(n1, n2) > 0) {
 		/* Orient the edge canonically. */
 		struct Node *tmp = n1;
@@ -590,6 +702,8 @@ graph_add_edge(struct Graph *g, const char *s1, const char *s2)
 		return 0;
 	}
 
+	LOADSTATS_BEGIN(g, t0);
+
 	/* 
 	 * If we must not add parallel edges, we need to check if an
 	 * edge parallel to the new edge already exists. If so, there
@@ -598,8 +712,10 @@ graph_add_edge(struct Graph *g, const char *s1, const char *s2)
 	 */
 	if ((g->flags & GRAPH_NOPARALLEL) && 
 	    (n1->comp != NULL) && (n1->comp == n2->comp)) {
-		if (graph_edge_exists(n1, n2))
+		if (graph_edge_exists(n1, n2)) {
+			LOADSTATS_END(g, t0, t_edge);
 			return 0;
+		}
 	}
 
 	/* Now do add an edge from n1 to n2. */
@@ -667,26 +783,396 @@ graph_add_edge(struct Graph *g, const char *s1, const char *s2)
 		 */
 		if (do_add_edge(g, n2, n1) < 0)
 			return -1;
+		loadstats_edges_added(g, t0, 2);
 		return 2; /* the number of edges added */
 	}
+	loadstats_edges_added(g, t0, 1);
 	return 1;
 }
 
+int
+graph_add_edge(struct Graph *g, const char *s1, const char *s2)
+{
+	struct Node *n1, *n2;
+
+	n1 = graph_add_node_internal(g, s1, 0);
+	if (n1 == NULL)
+		return -1;
+	n2 = graph_add_node_internal(g, s2, 0);
+	if (n2 == NULL) {
+		if (n1->comp == NULL)
+			graph_remove_last_node(g, n1);
+		return -1;
+	}
+	return graph_add_edge_nodes(g, n1, n2);
+}
+
+void
+graph_loadstats_init(struct graph_loadstats *ls, unsigned progress)
+{
+	memset(ls, 0, sizeof(*ls));
+	ls->progress = progress;
+	clock_gettime(CLOCK_MONOTONIC, &ls->start);
+	ls->start_ticks = loadstats_ticks();
+	ls->next_report = ls->start;
+	ls->next_report.tv_sec += progress;
+}
+
+int
+graph_set_numa_node(struct Graph *g, int node)
+{
+	if (arena_set_numa_node(&g->node_arena, node))
+		return -1;
+	return arena_set_numa_node(&g->edge_arena, node);
+}
+
+void
+graph_set_loadstats(struct Graph *g, struct graph_loadstats *ls)
+{
+	g->loadstats = ls;
+}
+
+static void
+loadstats_progress(const struct graph_loadstats *ls, const struct Graph *g, const struct timespec *now)
+{
+	double secs = timespec_diff(now, &ls->start);
+
+	if (secs <= 0)
+		return;
+	fprintf(stderr, "graph_add_file: %.0f s: %" PRIu64 " lines (%.0f/s), %.1f MiB (%.1f MiB/s), %u nodes, %" PRIu64 " edges\n",
+		secs, ls->lines, ls->lines / secs,
+		ls->bytes / 1048576.0, ls->bytes / 1048576.0 / secs,
+		g->node_count, ls->edges);
+}
+
+void
+graph_loadstats_print(const struct graph_loadstats *ls, const struct Graph *g, FILE *fp)
+{
+	struct timespec now;
+	double secs, tick;
+	uint64_t ticks;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ticks = loadstats_ticks() - ls->start_ticks;
+	secs = timespec_diff(&now, &ls->start);
+	if (secs <= 0 || ticks == 0)
+		return;
+	tick = secs / ticks;
+
+	fprintf(fp, "load: %" PRIu64 " lines, %.1f MiB in %.2f s (%.0f lines/s, %.1f MiB/s)\n",
+		ls->lines, ls->bytes / 1048576.0, secs,
+		ls->lines / secs, ls->bytes / 1048576.0 / secs);
+	fprintf(fp, "load: %u nodes, %" PRIu64 " edges\n", g->node_count, ls->edges);
+#define PHASE(name, t) fprintf(fp, "load: %-10s %10.3f s %5.1f%%\n", name, (t) * tick, 100.0 * (t) / ticks)
+	PHASE("tokenize", ls->t_tokenize);
+	PHASE("hash", ls->t_hash);
+	PHASE("alloc", ls->t_alloc);
+	PHASE("edges", ls->t_edge - ls->t_merge);
+	PHASE("merge", ls->t_merge);
+#undef PHASE
+}
+
+/*
+ * Binary edge lists. Nodes referenced by id are cached in a small
+ * open addressing hash table, so that only the first occurrence of an
+ * id costs a lookup (or insertion) in the graph's hash table.
+ */
+struct idmap {
+	uint64_t     *ids;
+	struct Node  **nodes;
+	uint64_t     mask;
+	uint64_t     count;
+};
+
+static int
+idmap_init(struct idmap *m, uint64_t size)
+{
+	m->mask = size - 1;
+	m->count = 0;
+	m->ids = malloc(size * sizeof(*m->ids));
+	m->nodes = calloc(size, sizeof(*m->nodes));
+	if (m->ids == NULL || m->nodes == NULL) {
+		free(m->ids);
+		free(m->nodes);
+		return -1;
+	}
+	return 0;
+}
+
+static void
+idmap_destroy(struct idmap *m)
+{
+	free(m->ids);
+	free(m->nodes);
+}
+
+static inline uint64_t
+idmap_slot(const struct idmap *m, uint64_t id)
+{
+	uint64_t i = (id * UINT64_C(0x9E3779B97F4A7C15)) >> 17;
+
+	while (m->nodes[i & m->mask] && m->ids[i & m->mask] != id)
+		i++;
+	return i & m->mask;
+}
+
+static int
+idmap_grow(struct idmap *m)
+{
+	struct idmap new;
+
+	if (idmap_init(&new, 2*(m->mask + 1)))
+		return -1;
+	for (uint64_t i = 0; i <= m->mask; ++i) {
+		if (m->nodes[i]) {
+			uint64_t j = idmap_slot(&new, m->ids[i]);
+			new.ids[j] = m->ids[i];
+			new.nodes[j] = m->nodes[i];
+		}
+	}
+	new.count = m->count;
+	idmap_destroy(m);
+	*m = new;
+	return 0;
+}
+
+struct binreader {
+	struct Graph  *g;
+	struct idmap  map;
+	char          *dict;     /* the dictionary strings, back to back */
+	uint64_t      *dictoff;  /* offset into dict of each entry */
+	uint64_t      dictcount;
+};
+
+/* Find or create the node with the given id. If create_comp, it is guaranteed to belong to a component. */
+static struct Node*
+binreader_node(struct binreader *br, uint64_t id, int create_comp)
+{
+	struct idmap *m = &br->map;
+	uint64_t slot = idmap_slot(m, id);
+	char buf[24];
+	const char *ident;
+	struct Node *n;
+
+	n = m->nodes[slot];
+	if (n != NULL) {
+		if (create_comp && n->comp == NULL && graph_add_node(br->g, n->ident) < 0)
+			return NULL;
+		return n;
+	}
+	/*
+	 * Keep the load factor below 1/2. Grow before creating the
+	 * node, so that there is nothing to undo if that fails.
+	 */
+	if (m->count + 1 > m->mask / 2) {
+		if (idmap_grow(m))
+			return NULL;
+		slot = idmap_slot(m, id);
+	}
+
+	if (br->dict) {
+		if (id >= br->dictcount) {
+			errno = EINVAL;
+			return NULL;
+		}
+		ident = br->dict + br->dictoff[id];
+	} else {
+		snprintf(buf, sizeof(buf), "%" PRIu64, id);
+		ident = buf;
+	}
+	n = graph_add_node_internal(br->g, ident, create_comp);
+	if (n == NULL)
+		return NULL;
+
+	m->ids[slot] = id;
+	m->nodes[slot] = n;
+	m->count++;
+	return n;
+}
+
+/*
+ * The entry count comes from the header, so it is not trusted to size
+ * anything: both arrays grow as the entries are actually read.
+ */
+static int
+binreader_read_dict(struct binreader *br, FILE *fp, uint64_t count)
+{
+	size_t cap = 4096, len = 0, offcap = 1024;
+	int c;
+
+	br->dictoff = malloc(offcap * sizeof(*br->dictoff));
+	br->dict = malloc(cap);
+	if (br->dictoff == NULL || br->dict == NULL)
+		return -1;
+
+	for (uint64_t i = 0; i < count; ++i) {
+		if (i == offcap) {
+			uint64_t *tmp = realloc(br->dictoff, 2*offcap * sizeof(*br->dictoff));
+			if (tmp == NULL)
+				return -1;
+			br->dictoff = tmp;
+			offcap *= 2;
+		}
+		br->dictoff[i] = len;
+		do {
+			c = getc(fp);
+			if (c == EOF) {
+				if (!ferror(fp))
+					errno = EINVAL;
+				return -1;
+			}
+			if (len == cap) {
+				char *tmp = realloc(br->dict, 2*cap);
+				if (tmp == NULL)
+					return -1;
+				br->dict = tmp;
+				cap *= 2;
+			}
+			br->dict[len++] = c;
+		} while (c != '\0');
+		br->dictcount = i + 1;
+	}
+	if (br->g->loadstats)
+		br->g->loadstats->bytes += len;
+	return 0;
+}
+
+int
+graph_add_binary_file(struct Graph *g, FILE *fp)
+{
+	struct graph_loadstats *ls = g->loadstats;
+	unsigned char hdr[16];
+	struct binreader br = { .g = g };
+	unsigned width;
+	uint64_t dictcount, none;
+	size_t got, rec, chunk = 1 << 16;
+	void *buf = NULL;
+	int rv = -1;
+
+	if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+	    memcmp(hdr, GRAPH_BINARY_MAGIC, 4) != 0 || hdr[4] != 1 ||
+	    (hdr[5] != 4 && hdr[5] != 8) || (hdr[6] & ~GRAPH_BINARY_DICT) != 0 || hdr[7] != 0) {
+		if (!ferror(fp))
+			errno = EINVAL;
+		return -1;
+	}
+	width = hdr[5];
+	none = width == 4 ? UINT32_MAX : UINT64_MAX;
+	memcpy(&dictcount, hdr + 8, sizeof(dictcount));
+	if (ls)
+		ls->bytes += sizeof(hdr);
+
+	if (idmap_init(&br.map, 1 << 10))
+		return -1;
+	if ((hdr[6] & GRAPH_BINARY_DICT) && binreader_read_dict(&br, fp, dictcount))
+		goto out;
+
+	rec = 2 * width;
+	buf = malloc(chunk * rec);
+	if (buf == NULL)
+		goto out;
+
+	/* fread() only comes up short at EOF or on error. */
+	while ((got = fread(buf, 1, chunk * rec, fp)) > 0) {
+		for (size_t i = 0; i < got / rec; ++i) {
+			uint64_t src, tgt;
+			struct Node *n1, *n2;
+			LOADSTATS_BEGIN(g, t0);
+
+			if (width == 4) {
+				src = ((const uint32_t *)buf)[2*i];
+				tgt = ((const uint32_t *)buf)[2*i+1];
+			} else {
+				src = ((const uint64_t *)buf)[2*i];
+				tgt = ((const uint64_t *)buf)[2*i+1];
+			}
+			LOADSTATS_END(g, t0, t_tokenize);
+
+			if (tgt == none) {
+				if (binreader_node(&br, src, 1) == NULL)
+					goto out;
+				continue;
+			}
+			n1 = binreader_node(&br, src, 0);
+			if (n1 == NULL)
+				goto out;
+			n2 = binreader_node(&br, tgt, 0);
+			if (n2 == NULL) {
+				/* As in graph_add_edge(); br.map goes away anyway. */
+				if (n1->comp == NULL)
+					graph_remove_last_node(g, n1);
+				goto out;
+			}
+			if (graph_add_edge_nodes(g, n1, n2) < 0)
+				goto out;
+		}
+		if (ls) {
+			ls->lines += got / rec;
+			ls->bytes += got;
+		}
+		if (got % rec) {
+			/* A truncated record. */
+			errno = EINVAL;
+			goto out;
+		}
+	}
+	if (ferror(fp))
+		goto out;
+	rv = 0;
+
+out:
+	free(buf);
+	free(br.dict);
+	free(br.dictoff);
+	idmap_destroy(&br.map);
+	return rv;
+}
+
 int
 graph_add_file(struct Graph *gph, FILE *fp)
 {
+	struct graph_loadstats *ls = gph->loadstats;
 	char *line  = NULL;
 	size_t lcap = 0;
 	ssize_t linelen;
 	int rv = 0;
+	int c;
 
-	while ((linelen = getline(&line, &lcap, fp)) > 0) {
+	c = getc(fp);
+	if (c == EOF)
+		return ferror(fp) ? -1 : 0;
+	ungetc(c, fp);
+	if (c == (unsigned char)GRAPH_BINARY_MAGIC[0])
+		return graph_add_binary_file(gph, fp);
+
+	while (1) {
 		char *nstr1;
 		char *nstr2;
+		LOADSTATS_BEGIN(gph, t0);
+
+		linelen = getline(&line, &lcap, fp);
+		if (linelen <= 0)
+			break;
 		nstr1 = strtok_r(line, " \t\n", &nstr2);
+		if (nstr1 != NULL)
+			nstr2 = strtok_r(NULL, " \t\n", &nstr2);
+		if (ls) {
+			ls->t_tokenize += loadstats_ticks() - t0;
+			ls->lines++;
+			ls->bytes += linelen;
+			/* Only look at the clock every 64k lines. */
+			if (ls->progress && (ls->lines & 0xffff) == 0) {
+				struct timespec now;
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				if (timespec_diff(&now, &ls->next_report) >= 0) {
+					loadstats_progress(ls, gph, &now);
+					ls->next_report = now;
+					ls->next_report.tv_sec += ls->progress;
+				}
+			}
+		}
 		if (nstr1 == NULL) /* blank line */
 			continue;
-		nstr2 = strtok_r(NULL, " \t\n", &nstr2);
 		if (nstr2 == NULL) {
 			if (graph_add_node(gph, nstr1) < 0) {
 				rv = -1;
@@ -705,3 +1191,234 @@ graph_add_file(struct Graph *gph, FILE *fp)
 	free(line);
 	return rv;
 }
+
+/*
+ * Merging is done by replaying the edges of src in dst, followed by
+ * the nodes of src which are still missing from dst (i.e., the
+ * isolated nodes of src). A node of src is resolved to a node of dst
+ * only once, using an array indexed by ->index; its hash value is
+ * reused, so no identifier is hashed again.
+ *
+ * If src has GRAPH_DUAL, each edge between distinct nodes is stored
+ * in both directions. The edges from a to b occur exactly as many
+ * times as the edges from b to a, so replaying only those going "up"
+ * (by ->index), as well as the loops, reproduces what was originally
+ * added to src.
+ */
+static struct Node*
+graph_merge_node(struct Graph *dst, struct Node **map, const struct Node *sn, int create_comp)
+{
+	struct Node *n = map[sn->index];
+
+	if (n != NULL) {
+		if (create_comp && n->comp == NULL && graph_add_node(dst, n->ident) < 0)
+			return NULL;
+		return n;
+	}
+	n = graph_add_node_hashed(dst, sn->ident, strlen(sn->ident), sn->hv, create_comp);
+	map[sn->index] = n;
+	return n;
+}
+
+int
+graph_merge(struct Graph *dst, const struct Graph *src)
+{
+	const struct Component *c;
+	const struct Node *sn;
+	const struct Edge *e;
+	struct Node **map;
+	int rv = -1;
+
+	if (dst == src) {
+		errno = EINVAL;
+		return -1;
+	}
+	map = calloc(src->node_count ? src->node_count : 1, sizeof(*map));
+	if (map == NULL)
+		return -1;
+
+	TAILQ_FOREACH(c, &src->components, list) {
+		STAILQ_FOREACH(sn, &c->nodes, complink) {
+			SLIST_FOREACH(e, &sn->out_edges, nodelink) {
+				struct Node *n1, *n2;
+
+				if ((src->flags & GRAPH_DUAL) && e->tgt->index < sn->index)
+					continue;
+				n1 = graph_merge_node(dst, map, sn, 0);
+				if (n1 == NULL)
+					goto out;
+				n2 = graph_merge_node(dst, map, e->tgt, 0);
+				if (n2 == NULL) {
+					if (n1->comp == NULL)
+						graph_remove_last_node(dst, n1);
+					map[sn->index] = NULL;
+					goto out;
+				}
+				if (graph_add_edge_nodes(dst, n1, n2) < 0)
+					goto out;
+			}
+		}
+	}
+	TAILQ_FOREACH(c, &src->components, list) {
+		STAILQ_FOREACH(sn, &c->nodes, complink) {
+			if (graph_merge_node(dst, map, sn, 1) == NULL)
+				goto out;
+		}
+	}
+	rv = 0;
+out:
+	free(map);
+	return rv;
+}
+
+/*
+ * Account the reading of a part in the destination's statistics. The
+ * edges are counted as they are merged, not as they were read.
+ */
+static void
+loadstats_add(struct graph_loadstats *sum, const struct graph_loadstats *ls)
+{
+	sum->lines += ls->lines;
+	sum->bytes += ls->bytes;
+	sum->t_tokenize += ls->t_tokenize;
+	sum->t_hash += ls->t_hash;
+	sum->t_alloc += ls->t_alloc;
+	sum->t_edge += ls->t_edge;
+	sum->t_merge += ls->t_merge;
+}
+
+/*
+ * Parallel loading: Each worker repeatedly claims the next file and
+ * reads it into a private graph with the same flags as the
+ * destination. The calling thread merges the partial graphs into the
+ * destination in file order, as soon as each becomes available, so
+ * that the result does not depend on scheduling. If the destination
+ * has load statistics, each part gets its own, which are added to the
+ * destination's once the part has been merged.
+ */
+struct loadjob {
+	FILE            **fps;
+	size_t          nfiles;
+	size_t          next;
+	struct Graph    *parts;
+	struct graph_loadstats *stats;  /* for each part, or NULL */
+	int             *status;  /* 0: pending, 1: done, -1: failed */
+	int             *errnos;
+	unsigned        flags;
+	pthread_mutex_t mtx;
+	pthread_cond_t  cond;
+};
+
+static void*
+graph_load_worker(void *arg)
+{
+	struct loadjob *job = arg;
+
+	while (1) {
+		size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		int st = 1;
+
+		if (i >= job->nfiles)
+			break;
+		if (graph_init(&job->parts[i], job->flags)) {
+			st = -1;
+		} else {
+			if (job->stats) {
+				graph_loadstats_init(&job->stats[i], 0);
+				graph_set_loadstats(&job->parts[i], &job->stats[i]);
+			}
+			if (graph_add_file(&job->parts[i], job->fps[i]))
+				st = -1;
+		}
+
+		pthread_mutex_lock(&job->mtx);
+		job->status[i] = st;
+		job->errnos[i] = errno;
+		pthread_cond_broadcast(&job->cond);
+		pthread_mutex_unlock(&job->mtx);
+	}
+	return NULL;
+}
+
+int
+graph_add_files(struct Graph *g, FILE **fps, size_t nfiles, unsigned nthreads)
+{
+	struct loadjob job;
+	pthread_t *tids;
+	unsigned started = 0;
+	int rv = 0, err = 0;
+
+	if (nthreads > nfiles)
+		nthreads = nfiles;
+	if (nthreads <= 1) {
+		for (size_t i = 0; i < nfiles; ++i) {
+			if (graph_add_file(g, fps[i]))
+				return -1;
+		}
+		return 0;
+	}
+
+	job.fps = fps;
+	job.nfiles = nfiles;
+	job.next = 0;
+	job.flags = g->flags;
+	job.parts = calloc(nfiles, sizeof(*job.parts));
+	job.stats = g->loadstats ? calloc(nfiles, sizeof(*job.stats)) : NULL;
+	job.status = calloc(nfiles, sizeof(*job.status));
+	job.errnos = calloc(nfiles, sizeof(*job.errnos));
+	tids = calloc(nthreads, sizeof(*tids));
+	if (!job.parts || (g->loadstats && !job.stats) || !job.status || !job.errnos || !tids) {
+		rv = -1;
+		err = ENOMEM;
+		goto out;
+	}
+	pthread_mutex_init(&job.mtx, NULL);
+	pthread_cond_init(&job.cond, NULL);
+
+	for (started = 0; started < nthreads; ++started) {
+		if (pthread_create(&tids[started], NULL, graph_load_worker, &job))
+			break;
+	}
+	if (started == 0) {
+		/* Do it ourselves. */
+		graph_load_worker(&job);
+	}
+
+	for (size_t i = 0; i < nfiles; ++i) {
+		pthread_mutex_lock(&job.mtx);
+		while (job.status[i] == 0)
+			pthread_cond_wait(&job.cond, &job.mtx);
+		pthread_mutex_unlock(&job.mtx);
+
+		if (rv == 0 && job.status[i] < 0) {
+			rv = -1;
+			err = job.errnos[i];
+		}
+		if (rv == 0 && graph_merge(g, &job.parts[i])) {
+			rv = -1;
+			err = errno;
+		}
+		if (job.stats)
+			loadstats_add(g->loadstats, &job.stats[i]);
+		/*
+		 * The parts are zeroed, and graph_init() cannot fail after
+		 * allocating anything, so this is safe even if it failed.
+		 */
+		graph_destroy(&job.parts[i]);
+	}
+
+	for (unsigned t = 0; t < started; ++t)
+		pthread_join(tids[t], NULL);
+	pthread_cond_destroy(&job.cond);
+	pthread_mutex_destroy(&job.mtx);
+
+out:
+	free(tids);
+	free(job.parts);
+	free(job.stats);
+	free(job.status);
+	free(job.errnos);
+	if (rv)
+		errno = err;
+	return rv;
+}
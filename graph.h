@@ -4,13 +4,15 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include <obstack.h>
+#include <time.h>
 #include <sys/queue.h>
 
+#include "arena.h"
+
 /*
  * A rather straight-forward "append-only" graph implementation. It is
  * somewhat memory-efficient; an edge only uses 16+epsilon bytes, and
- * a node uses 44+(length of identifier)+epsilon.
+ * a node uses 48+(length of identifier)+epsilon.
  */
 
 
@@ -26,6 +28,7 @@
  */
 
 struct Graph;
+struct graph_loadstats;
 struct Component;
 struct Edge;
 struct Node;
@@ -53,8 +56,10 @@ struct Graph {
 	uint32_t               node_count;
 	uint32_t               resize_threshold;
 
-	struct obstack         node_os;
-	struct obstack         edge_os;
+	struct arena           node_arena;
+	struct arena           edge_arena;
+
+	struct graph_loadstats *loadstats; /* NULL unless load statistics are wanted */
 };
 
 struct Component {
@@ -79,6 +84,7 @@ struct Node {
 	uint32_t           out_degree;
 	uint32_t           in_degree;
 	uint32_t           hv;        /* hash value of ident */
+	uint32_t           index;     /* order of creation, 0..node_count-1 */
 	char               ident[];   /* identifying string */
 };
 
@@ -94,6 +100,18 @@ struct Node {
 
 int graph_init(struct Graph *g, unsigned flags);
 
+/**
+ * graph_set_numa_node - bind the graph's memory to a NUMA node
+ *
+ * @node: The node, or -1 for the default memory policy.
+ *
+ * This only affects memory for nodes and edges allocated from now on,
+ * so it should be called right after graph_init().
+ *
+ * Returns: 0 on success, -1 on failure.
+ */
+int graph_set_numa_node(struct Graph *g, int node);
+
 /**
  * graph_destroy - destroy a graph
  *
@@ -135,10 +153,147 @@ int graph_add_node(struct Graph *g, const char *nstr);
  * an edge connecting the two nodes. Fields beyond the first two are
  * ignored.
  *
+ * If the file starts with the magic bytes of the binary edge list
+ * format (see below), it is read with graph_add_binary_file()
+ * instead.
+ *
+ * If load statistics are attached to @g (see below), the number of
+ * lines and bytes read are counted, and progress is reported if
+ * requested.
+ *
  * Returns: 0 on success, -1 on any failure.
  */
 int graph_add_file(struct Graph *g, FILE *fp);
 
+/*
+ * The binary edge list format consists of a 16 byte header
+ *
+ *   offset  size
+ *        0     4  magic, "\x89RVG"
+ *        4     1  version, 1
+ *        5     1  width of node ids, 4 or 8
+ *        6     1  flags, GRAPH_BINARY_DICT or 0
+ *        7     1  reserved, must be 0
+ *        8     8  number of dictionary entries
+ *
+ * followed by the dictionary, if GRAPH_BINARY_DICT is set: the given
+ * number of nul-terminated strings, the i'th of which is the
+ * identifier of the node with id i. Without a dictionary, a node is
+ * identified by the decimal representation of its id. The remainder
+ * of the file is a sequence of (source, target) pairs of node ids. A
+ * target of all ones (UINT32_MAX or UINT64_MAX, depending on the
+ * width) means that the pair contributes just the source node. All
+ * integers are in host byte order.
+ *
+ * Since each distinct id is only looked up in the graph's hash table
+ * once, loading a binary edge list is much cheaper than parsing the
+ * equivalent text.
+ */
+#define GRAPH_BINARY_MAGIC "\x89RVG"
+#define GRAPH_BINARY_DICT  0x01
+
+/**
+ * graph_add_binary_file - read a graph from a binary edge list
+ *
+ * Read fp, which must be positioned at the header, until EOF.
+ *
+ * Returns: 0 on success, -1 on any failure (errno is EINVAL if the
+ * input is malformed).
+ */
+int graph_add_binary_file(struct Graph *g, FILE *fp);
+
+
+/**
+ * graph_merge - add the contents of one graph to another
+ *
+ * @dst: The graph to add to
+ * @src: The graph to add from; it is not modified
+ *
+ * All the nodes and edges of @src are added to @dst, as if the calls
+ * to graph_add_edge() and graph_add_node() which built @src had been
+ * made on @dst, so @dst's flags are respected; components are merged
+ * as needed. If @src has GRAPH_DUAL, each pair of edges created by a
+ * single call counts as one edge.
+ *
+ * Returns: 0 on success, -1 on failure. In the latter case, @dst may
+ * contain part of @src.
+ */
+int graph_merge(struct Graph *dst, const struct Graph *src);
+
+/**
+ * graph_add_files - read a graph from several files, in parallel
+ *
+ * @fps: The files to read, as if by graph_add_file()
+ * @nfiles: The number of files
+ * @nthreads: The maximum number of threads to use
+ *
+ * The files are read by up to @nthreads threads, each building a
+ * private graph from one file at a time, which is then merged into
+ * @g using graph_merge(). The merges happen in the order of @fps, so
+ * the resulting nodes, edges and components are the same as if the
+ * files had been read one after another (though they may be created
+ * in a different order). If @nthreads is at most 1, that is exactly
+ * what happens.
+ *
+ * Load statistics attached to @g cover the reading of all files as
+ * well as the merging. The phase times are summed over the threads,
+ * so they may add up to more than the elapsed time.
+ *
+ * Returns: 0 on success, -1 on any failure.
+ */
+int graph_add_files(struct Graph *g, FILE **fps, size_t nfiles, unsigned nthreads);
+
+/*
+ * Load statistics.
+ *
+ * When a struct graph_loadstats is attached to a graph, the graph
+ * keeps track of how much time is spent in the various phases of
+ * building it: tokenizing input (graph_add_file() only), hashing and
+ * looking up identifiers, allocating new nodes, inserting edges and
+ * merging components. The time stamps are taken with rdtsc where
+ * available and clock_gettime() otherwise, so the overhead is a few
+ * cycles per phase; when no stats are attached, it is a single
+ * predictable branch.
+ *
+ * If @progress is non-zero, graph_add_file() prints a progress line
+ * on stderr roughly every @progress seconds.
+ */
+struct graph_loadstats {
+	uint64_t        lines;
+	uint64_t        bytes;
+	uint64_t        edges;
+
+	/* Time spent in each phase, in ticks. */
+	uint64_t        t_tokenize;
+	uint64_t        t_hash;
+	uint64_t        t_alloc;
+	uint64_t        t_edge;    /* includes t_merge */
+	uint64_t        t_merge;
+
+	unsigned        progress;
+
+	/* Private. */
+	uint64_t        start_ticks;
+	struct timespec start;
+	struct timespec next_report;
+};
+
+/* Zero the counters, and start the clock. */
+void graph_loadstats_init(struct graph_loadstats *ls, unsigned progress);
+
+/* Attach (or, if @ls is NULL, detach) load statistics to @g. */
+void graph_set_loadstats(struct Graph *g, struct graph_loadstats *ls);
+
+/* Print a summary of throughput and the per-phase timings to @fp. */
+void graph_loadstats_print(const struct graph_loadstats *ls, const struct Graph *g, FILE *fp);
+
+
+/**
+ * graph_find_node - look up a node by its identifier
+ *
+ * Returns: The node, or NULL if @ident does not identify a node of @g.
+ */
+const struct Node *graph_find_node(const struct Graph *g, const char *ident);
 
 /* Return true if there is an edge from src to tgt. */
 bool graph_edge_exists(const struct Node *src, const struct Node *tgt);
@@ -161,6 +316,51 @@ int graph_iterate_nodes(const struct Graph *g, int (*cb)(const struct Node *node
 /* Iterate over the edges of a graph. The edges are supplied as a pair of source and target node. */
 int graph_iterate_edges(const struct Graph *g, int (*cb)(const struct Node *src, const struct Node *tgt, void *ctx), void *ctx);
 
+/*
+ * Batched edge iteration. Instead of one callback per edge, the
+ * callback is handed arrays of up to GRAPH_EDGE_BATCH edges at a
+ * time, which amortizes the cost of the indirect call and allows the
+ * callback's loop over the batch to be optimized properly. The
+ * graph-wide variant fills batches across component boundaries.
+ */
+#define GRAPH_EDGE_BATCH 256
+
+struct EdgePair {
+	const struct Node  *src;
+	const struct Node  *tgt;
+};
+
+int graph_iterate_edge_batches(const struct Graph *g, int (*cb)(const struct EdgePair *edges, size_t count, void *ctx), void *ctx);
+int component_iterate_edge_batches(const struct Component *comp, int (*cb)(const struct EdgePair *edges, size_t count, void *ctx), void *ctx);
+
+/*
+ * Iterator macros, for callers who want the loop body inlined. The
+ * macros expanding to nested loops (GRAPH_FOREACH_NODE and the
+ * *_EDGE ones) need a variable for each level, and a 'break' in the
+ * body only leaves the innermost loop.
+ *
+ *   const struct Component *comp;
+ *   const struct Node *src;
+ *   const struct Edge *edge;
+ *   GRAPH_FOREACH_EDGE(comp, src, edge, g)
+ *           do_something(src, edge->tgt);
+ */
+#define GRAPH_FOREACH_COMPONENT(comp, g)			\
+	TAILQ_FOREACH(comp, &(g)->components, list)
+#define GRAPH_FOREACH_COMPONENT_NODE(node, comp)		\
+	STAILQ_FOREACH(node, &(comp)->nodes, complink)
+#define GRAPH_FOREACH_OUT_EDGE(edge, node)			\
+	SLIST_FOREACH(edge, &(node)->out_edges, nodelink)
+#define GRAPH_FOREACH_NODE(comp, node, g)			\
+	GRAPH_FOREACH_COMPONENT(comp, g)			\
+		GRAPH_FOREACH_COMPONENT_NODE(node, comp)
+#define GRAPH_FOREACH_COMPONENT_EDGE(src, edge, comp)		\
+	GRAPH_FOREACH_COMPONENT_NODE(src, comp)			\
+		GRAPH_FOREACH_OUT_EDGE(edge, src)
+#define GRAPH_FOREACH_EDGE(comp, src, edge, g)			\
+	GRAPH_FOREACH_COMPONENT(comp, g)			\
+		GRAPH_FOREACH_COMPONENT_EDGE(src, edge, comp)
+
 /* Iterate over the nodes of a component. */
 int component_iterate_nodes(const struct Component *comp, int (*cb)(const struct Node *node, void *ctx), void *ctx);
 /* Iterate over the edges of a component. The edges are supplied as a pair of source and target node. */
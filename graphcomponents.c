@@ -12,6 +12,7 @@
 #include <valgrind/valgrind.h>
 
 #include "graph.h"
+#include "core.h"
 
 
 /*
@@ -20,36 +21,56 @@
   -s: print summary
   -n: print nodes
   -e: print edges
+  -k: print core numbers of nodes
+  -K: print sizes of the k-cores
 
   -u: consider the graph undirected (actually directs all edges 'lexicographically')
   -p: disallow parallel edges (affects performance, sort -u is your friend)
   -l: ignore loops
 
+  -t: print load progress and timings to stderr
+  -j: number of threads for reading multiple input files
+
 */
 
 struct optionvalues {
 	const char    *sumfile;
 	const char    *nodefile;
 	const char    *edgefile;
+	const char    *corefile;
+	const char    *coresizefile;
 	int           summary;
 	int           nodes;
 	int           edges;
+	int           cores;
+	int           coresizes;
 	unsigned      graphflags;
+	int           timing;
+	unsigned      progress;
+	unsigned      threads;
 };
 
 struct optionvalues opt_val = {
 	.sumfile    = NULL,
 	.nodefile   = NULL,
 	.edgefile   = NULL,
+	.corefile   = NULL,
+	.coresizefile = NULL,
 	.summary    = 0,
 	.nodes      = 0,
 	.edges      = 0,
+	.cores      = 0,
+	.coresizes  = 0,
 	.graphflags = 0,
+	.timing     = 0,
+	.progress   = 0,
+	.threads    = 1,
 };
 
 struct context {
 	FILE *dest;
 	unsigned long cidx;
+	const uint32_t *core;
 };
 
 static int print_component_data(const struct Component *comp, void *ctx)
@@ -72,17 +93,31 @@ static int print_nodes_per_component(const struct Component *comp, void *ctx)
 	component_iterate_nodes(comp, &print_node_data, ctx);
 	return 0;
 }
-static int print_edge_data(const struct Node *src, const struct Node *tgt, void *ctx)
+static int print_node_core(const struct Node *node, void *ctx)
+{
+	struct context *nctx = ctx;
+	fprintf(nctx->dest, "%lu\t%s\t%u\n", nctx->cidx, node->ident, nctx->core[node->index]);
+	return 0;
+}
+static int print_cores_per_component(const struct Component *comp, void *ctx)
+{
+	struct context *nctx = ctx;
+	nctx->cidx++;
+	component_iterate_nodes(comp, &print_node_core, ctx);
+	return 0;
+}
+static int print_edge_data(const struct EdgePair *edges, size_t count, void *ctx)
 {
 	struct context *ectx = ctx;
-	fprintf(ectx->dest, "%lu\t%s\t%s\n", ectx->cidx, src->ident, tgt->ident);
+	for (size_t i = 0; i < count; ++i)
+		fprintf(ectx->dest, "%lu\t%s\t%s\n", ectx->cidx, edges[i].src->ident, edges[i].tgt->ident);
 	return 0;
 }
 static int print_edges_per_component(const struct Component *comp, void *ctx)
 {
 	struct context *ectx = ctx;
 	ectx->cidx++;
-	component_iterate_edges(comp, &print_edge_data, ctx);
+	component_iterate_edge_batches(comp, &print_edge_data, ctx);
 	return 0;
 }
 
@@ -93,17 +128,21 @@ help_exit(int status)
 {
 	FILE *fp = status ? stderr : stdout;
 	fprintf(fp, 
-		"graphcomponents [-s[file]] [-n[file]] [-e[file]] [-u] [-p] [-l]\n"
+		"graphcomponents [-s[file]] [-n[file]] [-e[file]] [-k[file]] [-K[file]]\n"
+		"                [-u] [-p] [-l] [-t[secs]] [-j N] [file...]\n"
 		"graphcomponents -h\n"
 		"\n"
-		"Reads a description of a graph from STDIN, computes its components, and prints\n"
-		"some information on those.\n"
+		"Reads a description of a graph from the given files, or STDIN if none are\n"
+		"given, computes its components, and prints some information on those.\n"
 		"\n"
 		"Each line of input should consist of one or two whitespace separated fields.\n"
 		"Each string identifies a node in the graph; a new node is created whenever\n"
 		"a new string is encountered. If a line contains two fields, that defines an edge\n"
 		"which is added to the graph.\n"
 		"\n"
+		"Alternatively, the input can be a binary edge list (see graph.h), which is\n"
+		"recognized by its magic header and is much faster to load.\n"
+		"\n"
 		"What information to print, and where, is controlled by the given options:\n"
 		"\n"
 		"-s,--summary   print a summary of the components (number of nodes and edges)\n"
@@ -112,6 +151,13 @@ help_exit(int status)
 		"               to file, or stdout if no filename is given\n"
 		"-e,--edges     print the edges of the graph by component\n"
 		"               to file, or stdout if no filename is given\n"
+		"-k,--cores     print the core number of each node by component\n"
+		"               to file, or stdout if no filename is given\n"
+		"-K,--core-sizes\n"
+		"               for each k up to the degeneracy of the graph, print the\n"
+		"               number of nodes with core number k and the size of the k-core\n"
+		"               to file, or stdout if no filename is given\n"
+		"               (core numbers ignore direction, loops and parallel edges)\n"
 		"\n"
 		"Please note: When using the short option, no space is allowed before\n"
 		"the filename. When using the long option, an equal sign is required before\n"
@@ -121,7 +167,7 @@ help_exit(int status)
 		"    or\n"
 		"             graphcomponents --nodes=nodefile.txt\n"
 		"\n"
-		"If none of -s,-n,-e are given, -s is assumed.\n"
+		"If none of -s,-n,-e,-k,-K are given, -s is assumed.\n"
 		"\n"
 		"-u,--undirected  consider the graph undirected (actually simply directs\n"
 		"                 each edge in some internal canonical order)\n"
@@ -129,6 +175,12 @@ help_exit(int status)
 		"                 your friend)\n"
 		"-l,--noloop      disallow (ignore) loops (edges connecting a node to itself)\n"
 		"\n"
+		"-t,--timing      print throughput and time spent in each phase of loading\n"
+		"                 the graph to stderr; if secs is given, also print a\n"
+		"                 progress line every secs seconds\n"
+		"-j,--threads     read up to N input files in parallel, merging the partial\n"
+		"                 graphs as they are done\n"
+		"\n"
 		"-h,--help        print help and exit\n"
 
 		);
@@ -143,16 +195,20 @@ parse_options(int argc, char *argv[])
 			{"summary",    optional_argument, 0, 's'},
 			{"nodes",      optional_argument, 0, 'n'},
 			{"edges",      optional_argument, 0, 'e'},
+			{"cores",      optional_argument, 0, 'k'},
+			{"core-sizes", optional_argument, 0, 'K'},
 			{"undirected", no_argument, 0, 'u'},
 			{"noparallel", no_argument, 0, 'p'},
 			{"noloop",     no_argument, 0, 'l'},
+			{"timing",     optional_argument, 0, 't'},
+			{"threads",    required_argument, 0, 'j'},
 			{"help",       no_argument, 0, 'h'},
 			{0, 0, 0, 0}
 		};
 		int option_index = 0;
 		int c;
 
-		c = getopt_long(argc, argv, "s::n::e::uplh", Options, &option_index);
+		c = getopt_long(argc, argv, "s::n::e::k::K::uplt::j:h", Options, &option_index);
 		if (c == -1)
 			break;
 		switch(c) {
@@ -162,9 +218,21 @@ parse_options(int argc, char *argv[])
 		case 's': opt_val.summary = 1; opt_val.sumfile = optarg; break;
 		case 'n': opt_val.nodes = 1; opt_val.nodefile = optarg; break;
 		case 'e': opt_val.edges = 1; opt_val.edgefile = optarg; break;
+		case 'k': opt_val.cores = 1; opt_val.corefile = optarg; break;
+		case 'K': opt_val.coresizes = 1; opt_val.coresizefile = optarg; break;
 		case 'u': opt_val.graphflags |= GRAPH_UNDIRECTED; break;
 		case 'p': opt_val.graphflags |= GRAPH_NOPARALLEL; break;
 		case 'l': opt_val.graphflags |= GRAPH_NOLOOP; break;
+		case 't':
+			opt_val.timing = 1;
+			if (optarg)
+				opt_val.progress = strtoul(optarg, NULL, 10);
+			break;
+		case 'j':
+			opt_val.threads = strtoul(optarg, NULL, 10);
+			if (opt_val.threads == 0)
+				help_exit(1);
+			break;
 
 		case '?':
 			help_exit(1);
@@ -173,40 +241,113 @@ parse_options(int argc, char *argv[])
 			assert(0);
 		}
 	}
-	if (!opt_val.summary && !opt_val.nodes && !opt_val.edges)
+	if (!opt_val.summary && !opt_val.nodes && !opt_val.edges && !opt_val.cores && !opt_val.coresizes)
 		opt_val.summary = 1;
 }
 
-static void do_output(const char *filename, int (*cb)(const struct Component *, void *), const struct Graph *gph)
+static FILE *open_output(const char *filename)
 {
-	struct context ctx;
-	ctx.cidx = 0;
-	ctx.dest = (filename == NULL) ? stdout : fopen(filename, "w");
-	if (ctx.dest == NULL) {
+	FILE *fp = (filename == NULL) ? stdout : fopen(filename, "w");
+	if (fp == NULL) {
 		error(2, errno, "could not open '%s' for writing", filename);    
 	}
+	return fp;
+}
+
+static void do_output(const char *filename, int (*cb)(const struct Component *, void *), const struct Graph *gph,
+		      const uint32_t *core)
+{
+	struct context ctx;
+	ctx.cidx = 0;
+	ctx.core = core;
+	ctx.dest = open_output(filename);
 	graph_iterate_components(gph, cb, &ctx);
 	if (filename != NULL)
 		fclose(ctx.dest);
 }
 
+static void print_core_sizes(const char *filename, const uint32_t *core, uint32_t count, uint32_t degeneracy)
+{
+	FILE *fp = open_output(filename);
+	uint32_t *size = calloc((size_t)degeneracy + 1, sizeof(*size));
+	uint32_t kcore = count;
+
+	if (size == NULL)
+		error(2, errno, "calloc()");
+	for (uint32_t i = 0; i < count; ++i)
+		size[core[i]]++;
+	for (uint32_t k = 0; k <= degeneracy; ++k) {
+		fprintf(fp, "%u\t%u\t%u\n", k, size[k], kcore);
+		kcore -= size[k];
+	}
+	free(size);
+	if (filename != NULL)
+		fclose(fp);
+}
+
 int main(int argc, char *argv[]) {
 	struct Graph gph;
+	struct graph_loadstats ls;
 
 	parse_options(argc, argv);
 
 	if (graph_init(&gph, opt_val.graphflags))
 		error(2, errno, "initialization failed");
 
-	if (graph_add_file(&gph, stdin))
-		error(2, errno, "reading graph failed");
+	if (opt_val.timing) {
+		graph_loadstats_init(&ls, opt_val.progress);
+		graph_set_loadstats(&gph, &ls);
+	}
+
+	if (optind == argc) {
+		if (graph_add_file(&gph, stdin))
+			error(2, errno, "reading graph failed");
+	} else {
+		int nfiles = argc - optind;
+		FILE **fps = calloc(nfiles, sizeof(*fps));
+		if (fps == NULL)
+			error(2, errno, "calloc()");
+		for (int i = 0; i < nfiles; ++i) {
+			const char *name = argv[optind + i];
+			fps[i] = strcmp(name, "-") ? fopen(name, "r") : stdin;
+			if (fps[i] == NULL)
+				error(2, errno, "could not open '%s' for reading", name);
+		}
+		if (graph_add_files(&gph, fps, nfiles, opt_val.threads))
+			error(2, errno, "reading graph failed");
+		for (int i = 0; i < nfiles; ++i) {
+			if (fps[i] != stdin)
+				fclose(fps[i]);
+		}
+		free(fps);
+	}
+
+	if (opt_val.timing) {
+		graph_loadstats_print(&ls, &gph, stderr);
+		graph_set_loadstats(&gph, NULL);
+	}
 
 	if (opt_val.summary)
-		do_output(opt_val.sumfile, &print_component_data, &gph);
+		do_output(opt_val.sumfile, &print_component_data, &gph, NULL);
 	if (opt_val.nodes)
-		do_output(opt_val.nodefile, &print_nodes_per_component, &gph);
+		do_output(opt_val.nodefile, &print_nodes_per_component, &gph, NULL);
 	if (opt_val.edges)
-		do_output(opt_val.edgefile, &print_edges_per_component, &gph);
+		do_output(opt_val.edgefile, &print_edges_per_component, &gph, NULL);
+	if (opt_val.cores || opt_val.coresizes) {
+		uint32_t *core = malloc((gph.node_count ? gph.node_count : 1) * sizeof(*core));
+		int64_t degeneracy;
+
+		if (core == NULL)
+			error(2, errno, "malloc()");
+		degeneracy = graph_core_numbers(&gph, core);
+		if (degeneracy < 0)
+			error(2, errno, "computing core numbers failed");
+		if (opt_val.cores)
+			do_output(opt_val.corefile, &print_cores_per_component, &gph, core);
+		if (opt_val.coresizes)
+			print_core_sizes(opt_val.coresizefile, core, gph.node_count, degeneracy);
+		free(core);
+	}
 
 	if (RUNNING_ON_VALGRIND)
 		graph_destroy(&gph);
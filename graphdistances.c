@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <error.h>
+#include <errno.h>
+
+#include <getopt.h>
+
+#include <valgrind/valgrind.h>
+
+#include "graph.h"
+#include "frozen.h"
+#include "bfs.h"
+
+struct optionvalues {
+	const char  **sources;
+	size_t      nsources;
+	bool        diameter;
+	int         order;     /* -1 for none, otherwise an enum frozen_order */
+};
+
+struct optionvalues opt_val = {
+	.sources = NULL,
+	.nsources = 0,
+	.diameter = false,
+	.order = -1,
+};
+
+static void
+usage(FILE *fp)
+{
+	fputs("graphdistances [-s node]... [-d] [-o order]\n"
+	      "graphdistances -h\n",
+	      fp);
+}
+
+static void
+help(FILE *fp)
+{
+	usage(fp);
+	fputs("\n"
+	      "Reads a description of a graph from STDIN, and prints hop distances in it,\n"
+	      "ignoring the direction of edges.\n"
+	      "\n"
+	      "Each line of input should consist of one or two whitespace separated fields.\n"
+	      "Each string identifies a node in the graph; a new node is created whenever\n"
+	      "a new string is encountered. If a line contains two fields, that defines an edge\n"
+	      "which is added to the graph.\n"
+	      "\n"
+	      "Alternatively, the input can be a binary edge list (see graph.h), which is\n"
+	      "recognized by its magic header and is much faster to load.\n"
+	      "\n"
+	      "-s,--source      compute the distance from node to every node reachable from\n"
+	      "                 it, printing the node and its distance; if given more than\n"
+	      "                 once, the distance is to the nearest of the sources\n"
+	      "-d,--diameter    for each component, print its index, number of nodes, a\n"
+	      "                 lower bound for its diameter (found by a double sweep) and\n"
+	      "                 the endpoints of a path of that length\n"
+	      "-o,--order       renumber the nodes internally before searching, for better\n"
+	      "                 memory locality; order is one of degree, bfs, component\n"
+	      "\n"
+	      "If neither -s nor -d is given, -d is assumed.\n"
+	      "\n"
+	      "-h,--help        print help and exit\n",
+	      fp);
+}
+
+static void
+parse_options(int argc, char *argv[])
+{
+	while (1) {
+		static struct option Options[] = {
+			{"help",       no_argument, 0, 'h'},
+			{"source",     required_argument, 0, 's'},
+			{"diameter",   no_argument, 0, 'd'},
+			{"order",      required_argument, 0, 'o'},
+			{0, 0, 0, 0},
+		};
+		int option_index = 0;
+		int c;
+
+		c = getopt_long(argc, argv, "s:do:h", Options, &option_index);
+		if (c == -1)
+			break;
+		switch(c) {
+		case 'h':
+			help(stdout);
+			exit(0);
+			break;
+		case 's':
+			opt_val.sources = realloc(opt_val.sources, (opt_val.nsources + 1) * sizeof(*opt_val.sources));
+			if (opt_val.sources == NULL)
+				error(2, errno, "realloc()");
+			opt_val.sources[opt_val.nsources++] = optarg;
+			break;
+		case 'd':
+			opt_val.diameter = true;
+			break;
+		case 'o':
+			if (!strcmp(optarg, "degree"))
+				opt_val.order = FROZEN_ORDER_DEGREE;
+			else if (!strcmp(optarg, "bfs"))
+				opt_val.order = FROZEN_ORDER_BFS;
+			else if (!strcmp(optarg, "component"))
+				opt_val.order = FROZEN_ORDER_COMPONENT;
+			else {
+				usage(stderr);
+				exit(1);
+			}
+			break;
+		case '?':
+			usage(stderr);
+			exit(1);
+			break;
+		default: /* should never happen */
+			assert(0);
+		}
+	}
+	if (!opt_val.nsources && !opt_val.diameter)
+		opt_val.diameter = true;
+}
+
+static void
+print_distances(const struct FrozenGraph *fg, struct BFS *bfs, const struct Graph *gph)
+{
+	uint32_t *src = malloc(opt_val.nsources * sizeof(*src));
+
+	if (src == NULL)
+		error(2, errno, "malloc()");
+	for (size_t i = 0; i < opt_val.nsources; ++i) {
+		const struct Node *node = graph_find_node(gph, opt_val.sources[i]);
+		if (node == NULL)
+			error(2, 0, "no such node: '%s'", opt_val.sources[i]);
+		src[i] = frozen_node(fg, node);
+	}
+	if (bfs_run(bfs, src, opt_val.nsources))
+		error(2, errno, "bfs_run()");
+	for (uint32_t i = 0; i < bfs->reached; ++i) {
+		uint32_t v = bfs->visited[i];
+		printf("%s\t%u\n", fg->nodes[v]->ident, bfs->dist[v]);
+	}
+	free(src);
+}
+
+static void
+print_diameters(const struct FrozenGraph *fg, struct BFS *bfs)
+{
+	/* Start each double sweep from a node of maximal degree in its component. */
+	uint32_t *start = malloc((fg->comp_count ? fg->comp_count : 1) * sizeof(*start));
+	uint32_t *size = calloc(fg->comp_count ? fg->comp_count : 1, sizeof(*size));
+
+	if (start == NULL || size == NULL)
+		error(2, errno, "malloc()");
+	for (uint32_t v = 0; v < fg->node_count; ++v) {
+		uint32_t c = fg->comp[v];
+		if (size[c]++ == 0 || frozen_degree(fg, v) > frozen_degree(fg, start[c]))
+			start[c] = v;
+	}
+	for (uint32_t c = 0; c < fg->comp_count; ++c) {
+		uint32_t a, b, diam;
+
+		diam = bfs_double_sweep(bfs, start[c], &a, &b);
+		printf("%u\t%u\t%u\t%s\t%s\n", c + 1, size[c], diam, fg->nodes[a]->ident, fg->nodes[b]->ident);
+	}
+	free(start);
+	free(size);
+}
+
+int main(int argc, char *argv[]) {
+	struct Graph gph;
+	struct FrozenGraph fg;
+	struct BFS bfs;
+
+	parse_options(argc, argv);
+
+	if (graph_init(&gph, 0))
+		error(2, errno, "initialization failed");
+
+	if (graph_add_file(&gph, stdin))
+		error(2, errno, "reading graph failed");
+
+	if (graph_freeze(&gph, &fg, FROZEN_SYMMETRIC))
+		error(2, errno, "graph_freeze()");
+	if (opt_val.order >= 0 && frozen_reorder(&fg, opt_val.order))
+		error(2, errno, "frozen_reorder()");
+	if (bfs_init(&bfs, &fg))
+		error(2, errno, "bfs_init()");
+
+	if (opt_val.nsources)
+		print_distances(&fg, &bfs, &gph);
+	if (opt_val.diameter)
+		print_diameters(&fg, &bfs);
+
+	if (RUNNING_ON_VALGRIND) {
+		bfs_destroy(&bfs);
+		frozen_destroy(&fg);
+		graph_destroy(&gph);
+		free(opt_val.sources);
+	}
+
+	return 0;
+}
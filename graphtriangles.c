@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#include <error.h>
+#include <errno.h>
+
+#include <getopt.h>
+
+#include <valgrind/valgrind.h>
+
+#include "graph.h"
+#include "frozen.h"
+#include "triangles.h"
+
+
+/*
+  options
+
+  -s: print summary
+  -n: print nodes
+
+  -u, -p, -l: as for graphcomponents
+  -j: number of threads
+*/
+
+struct optionvalues {
+	const char    *sumfile;
+	const char    *nodefile;
+	int           summary;
+	int           nodes;
+	unsigned      graphflags;
+	unsigned      threads;
+};
+
+struct optionvalues opt_val = {
+	.sumfile    = NULL,
+	.nodefile   = NULL,
+	.summary    = 0,
+	.nodes      = 0,
+	.graphflags = 0,
+	.threads    = 1,
+};
+
+struct context {
+	FILE *dest;
+	unsigned long cidx;
+	const struct FrozenGraph *fg;
+	const struct TriangleStats *ts;
+};
+
+static int print_node_data(const struct Node *node, void *ctx)
+{
+	struct context *nctx = ctx;
+	uint32_t v = frozen_node(nctx->fg, node);
+	fprintf(nctx->dest, "%lu\t%s\t%u\t%" PRIu64 "\t%.6f\n", nctx->cidx, node->ident,
+		frozen_degree(nctx->fg, v), nctx->ts->per_node[v], triangles_clustering(nctx->fg, nctx->ts, v));
+	return 0;
+}
+static int print_nodes_per_component(const struct Component *comp, void *ctx)
+{
+	struct context *nctx = ctx;
+	nctx->cidx++;
+	component_iterate_nodes(comp, &print_node_data, ctx);
+	return 0;
+}
+
+static void __attribute__((__noreturn__))
+help_exit(int status)
+{
+	FILE *fp = status ? stderr : stdout;
+	fprintf(fp,
+		"graphtriangles [-s[file]] [-n[file]] [-u] [-p] [-l] [-j N]\n"
+		"graphtriangles -h\n"
+		"\n"
+		"Reads a description of a graph from STDIN, and counts its triangles.\n"
+		"\n"
+		"The input format is the same as for graphcomponents, and so are the\n"
+		"options -u, -p and -l. The triangles are those of the underlying simple\n"
+		"undirected graph, i.e. ignoring direction, loops and parallel edges.\n"
+		"\n"
+		"-s,--summary   print the number of nodes, edges, triangles and wedges\n"
+		"               (paths of length 2), the transitivity (global clustering\n"
+		"               coefficient) and the average local clustering coefficient\n"
+		"               to file, or stdout if no filename is given\n"
+		"-n,--nodes     print, by component, each node with its degree, number of\n"
+		"               triangles and local clustering coefficient\n"
+		"               to file, or stdout if no filename is given\n"
+		"\n"
+		"If neither -s nor -n is given, -s is assumed.\n"
+		"\n"
+		"-u,--undirected  consider the graph undirected\n"
+		"-p,--noparallel  disallow parallel edges\n"
+		"-l,--noloop      disallow (ignore) loops\n"
+		"-j,--threads     count using N threads\n"
+		"\n"
+		"-h,--help        print help and exit\n"
+		);
+	exit(status);
+}
+
+static void
+parse_options(int argc, char *argv[])
+{
+	while (1) {
+		static struct option Options[] = {
+			{"summary",    optional_argument, 0, 's'},
+			{"nodes",      optional_argument, 0, 'n'},
+			{"undirected", no_argument, 0, 'u'},
+			{"noparallel", no_argument, 0, 'p'},
+			{"noloop",     no_argument, 0, 'l'},
+			{"threads",    required_argument, 0, 'j'},
+			{"help",       no_argument, 0, 'h'},
+			{0, 0, 0, 0}
+		};
+		int option_index = 0;
+		int c;
+
+		c = getopt_long(argc, argv, "s::n::uplj:h", Options, &option_index);
+		if (c == -1)
+			break;
+		switch(c) {
+		case 'h':
+			help_exit(0);
+			break;
+		case 's': opt_val.summary = 1; opt_val.sumfile = optarg; break;
+		case 'n': opt_val.nodes = 1; opt_val.nodefile = optarg; break;
+		case 'u': opt_val.graphflags |= GRAPH_UNDIRECTED; break;
+		case 'p': opt_val.graphflags |= GRAPH_NOPARALLEL; break;
+		case 'l': opt_val.graphflags |= GRAPH_NOLOOP; break;
+		case 'j':
+			opt_val.threads = strtoul(optarg, NULL, 10);
+			if (opt_val.threads == 0)
+				help_exit(1);
+			break;
+
+		case '?':
+			help_exit(1);
+			break;
+		default: /* should never happen */
+			assert(0);
+		}
+	}
+	if (!opt_val.summary && !opt_val.nodes)
+		opt_val.summary = 1;
+}
+
+static FILE *open_output(const char *filename)
+{
+	FILE *fp = (filename == NULL) ? stdout : fopen(filename, "w");
+	if (fp == NULL)
+		error(2, errno, "could not open '%s' for writing", filename);
+	return fp;
+}
+
+static void print_summary(const char *filename, const struct FrozenGraph *fg, const struct TriangleStats *ts)
+{
+	FILE *fp = open_output(filename);
+	double avg = 0.0;
+
+	for (uint32_t v = 0; v < fg->node_count; ++v)
+		avg += triangles_clustering(fg, ts, v);
+	if (fg->node_count)
+		avg /= fg->node_count;
+	fprintf(fp, "%u\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%.6f\t%.6f\n", fg->node_count, fg->adj_count / 2,
+		ts->triangles, ts->wedges, triangles_transitivity(ts), avg);
+	if (filename != NULL)
+		fclose(fp);
+}
+
+int main(int argc, char *argv[]) {
+	struct Graph gph;
+	struct FrozenGraph fg;
+	struct TriangleStats ts;
+
+	parse_options(argc, argv);
+
+	if (graph_init(&gph, opt_val.graphflags))
+		error(2, errno, "initialization failed");
+
+	if (graph_add_file(&gph, stdin))
+		error(2, errno, "reading graph failed");
+
+	if (graph_freeze(&gph, &fg, FROZEN_SYMMETRIC))
+		error(2, errno, "graph_freeze()");
+
+	ts.per_node = malloc((fg.node_count ? fg.node_count : 1) * sizeof(*ts.per_node));
+	if (ts.per_node == NULL)
+		error(2, errno, "malloc()");
+	if (frozen_count_triangles(&fg, &ts, opt_val.threads))
+		error(2, errno, "counting triangles failed");
+
+	if (opt_val.summary)
+		print_summary(opt_val.sumfile, &fg, &ts);
+	if (opt_val.nodes) {
+		struct context ctx = { .cidx = 0, .fg = &fg, .ts = &ts };
+		ctx.dest = open_output(opt_val.nodefile);
+		graph_iterate_components(&gph, print_nodes_per_component, &ctx);
+		if (opt_val.nodefile != NULL)
+			fclose(ctx.dest);
+	}
+
+	if (RUNNING_ON_VALGRIND) {
+		free(ts.per_node);
+		frozen_destroy(&fg);
+		graph_destroy(&gph);
+	}
+
+	return 0;
+}
@@ -0,0 +1,392 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "graph.h"
+#include "frozen.h"
+#include "core.h"
+#include "sortedset.h"
+#include "maxclique.h"
+
+/*
+ * The subproblem of a node v has its candidates numbered 0..k-1 in
+ * decreasing order of their degree within the subproblem, the
+ * initial order MCQ wants for its colouring. Row i of adj is the neighbourhood of candidate i, W words long.
+ *
+ * Branches at depth t keep their candidate set in P + t*W, and their
+ * colouring (candidates in order of colour, and the colours) in
+ * order + t*k and color + t*k. These are allocated for the largest
+ * possible k and grown as the search descends, so callers must not
+ * hold pointers into them across a recursive call.
+ */
+struct mcsearch {
+	const struct FrozenGraph *fg;
+	uint32_t   k, W;
+	uint32_t   max_k, max_W;
+	uint64_t   *adj;
+	uint64_t   *P;
+	uint32_t   *order, *color;
+	uint32_t   depth_cap;
+	uint64_t   *U, *Q;      /* colouring scratch, W words each */
+	uint32_t   *sub;        /* frozen node of each candidate */
+	uint32_t   *R;          /* R[1..] are candidates; R[0] is the node of the subproblem */
+	uint32_t   *best;       /* frozen nodes of the best clique */
+	uint32_t   best_size;
+	uint64_t   calls;
+};
+
+static int
+mc_reserve(struct mcsearch *ms, uint32_t depth)
+{
+	uint32_t cap = ms->depth_cap;
+	uint64_t *P;
+	uint32_t *order, *color;
+
+	if (depth < cap)
+		return 0;
+	while (cap <= depth)
+		cap = cap ? 2 * cap : 8;
+	P = realloc(ms->P, (size_t)cap * ms->max_W * sizeof(*P));
+	if (P == NULL)
+		return -1;
+	ms->P = P;
+	order = realloc(ms->order, (size_t)cap * ms->max_k * sizeof(*order));
+	if (order == NULL)
+		return -1;
+	ms->order = order;
+	color = realloc(ms->color, (size_t)cap * ms->max_k * sizeof(*color));
+	if (color == NULL)
+		return -1;
+	ms->color = color;
+	ms->depth_cap = cap;
+	return 0;
+}
+
+/*
+ * Greedy sequential colouring of the candidates at @depth. Only the
+ * candidates whose colour could still extend R (of size @rsize) to
+ * beat the best clique are stored; colours are non-decreasing along
+ * the stored order, and branching walks it backwards, so the others
+ * would never be reached anyway.
+ */
+static uint32_t
+mc_color(struct mcsearch *ms, uint32_t depth, uint32_t rsize)
+{
+	uint32_t W = ms->W, n = 0, c = 0, first = 0;
+	const uint64_t *P = ms->P + (size_t)depth * W;
+	uint32_t *order = ms->order + (size_t)depth * ms->k;
+	uint32_t *color = ms->color + (size_t)depth * ms->k;
+	uint64_t *U = ms->U, *Q = ms->Q;
+
+	memcpy(U, P, W * sizeof(*U));
+	while (1) {
+		while (first < W && !U[first])
+			first++;
+		if (first == W)
+			break;
+		c++;
+		memcpy(Q + first, U + first, (W - first) * sizeof(*Q));
+		for (uint32_t w = first; w < W; ++w) {
+			while (Q[w]) {
+				uint32_t v = w * 64 + __builtin_ctzll(Q[w]);
+				const uint64_t *row = ms->adj + (size_t)v * W;
+
+				Q[w] &= Q[w] - 1;
+				U[w] &= ~(UINT64_C(1) << (v % 64));
+				for (uint32_t x = w; x < W; ++x)
+					Q[x] &= ~row[x];
+				if (rsize + c > ms->best_size) {
+					order[n] = v;
+					color[n] = c;
+					n++;
+				}
+			}
+		}
+	}
+	return n;
+}
+
+static void
+mc_record(struct mcsearch *ms, uint32_t size)
+{
+	ms->best[0] = ms->R[0];
+	for (uint32_t j = 1; j < size; ++j)
+		ms->best[j] = ms->sub[ms->R[j]];
+	ms->best_size = size;
+}
+
+/* Search the candidates at @depth for a clique extending R[0..rsize-1]. */
+static int
+mc_expand(struct mcsearch *ms, uint32_t depth, uint32_t rsize)
+{
+	uint32_t W = ms->W, n;
+
+	ms->calls++;
+	if (mc_reserve(ms, depth + 1))
+		return -1;
+	n = mc_color(ms, depth, rsize);
+	for (uint32_t i = n; i-- > 0; ) {
+		size_t o = (size_t)depth * ms->k + i;
+		uint32_t v = ms->order[o];
+		const uint64_t *row = ms->adj + (size_t)v * W;
+		uint64_t *P = ms->P + (size_t)depth * W, *NP = P + W;
+		uint64_t any = 0;
+
+		if (rsize + ms->color[o] <= ms->best_size)
+			break;
+		ms->R[rsize] = v;
+		for (uint32_t w = 0; w < W; ++w) {
+			NP[w] = P[w] & row[w];
+			any |= NP[w];
+		}
+		if (!any) {
+			if (rsize + 1 > ms->best_size)
+				mc_record(ms, rsize + 1);
+		} else if (mc_expand(ms, depth + 1, rsize + 1)) {
+			return -1;
+		}
+		P = ms->P + (size_t)depth * W;
+		P[v / 64] &= ~(UINT64_C(1) << (v % 64));
+	}
+	return 0;
+}
+
+/*
+ * Collect into @out the neighbours of v later in degeneracy order
+ * which are in the (bound)-core, in increasing order of node number.
+ */
+static uint32_t
+later_neighbours(const struct FrozenGraph *fg, const uint32_t *rank, const uint32_t *core,
+		 uint32_t v, uint32_t bound, uint32_t *out)
+{
+	uint32_t k = 0;
+
+	for (uint64_t j = fg->offset[v]; j < fg->offset[v+1]; ++j) {
+		uint32_t u = fg->adj[j];
+		if (rank[u] > rank[v] && core[u] >= bound)
+			out[k++] = u;
+	}
+	return k;
+}
+
+/*
+ * Grow a clique from v by repeatedly adding the remaining common
+ * neighbour latest in degeneracy order. @cand is clobbered.
+ */
+static void
+greedy_clique(struct mcsearch *ms, const uint32_t *rank, const uint32_t *core, uint32_t v, uint32_t *cand)
+{
+	const struct FrozenGraph *fg = ms->fg;
+	uint32_t nc = later_neighbours(fg, rank, core, v, ms->best_size, cand);
+	uint32_t size = 1;
+
+	if (nc + 1 <= ms->best_size)
+		return;
+	ms->R[0] = v;
+	while (nc) {
+		uint32_t u = cand[0];
+		for (uint32_t j = 1; j < nc; ++j) {
+			if (rank[cand[j]] > rank[u])
+				u = cand[j];
+		}
+		ms->R[size++] = u;
+		nc = sortedset_intersect(cand, nc, fg->adj + fg->offset[u], frozen_degree(fg, u), cand);
+	}
+	if (size > ms->best_size) {
+		memcpy(ms->best, ms->R, size * sizeof(*ms->best));
+		ms->best_size = size;
+	}
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Set up the subproblem of v from its later neighbours @ids (sorted
+ * by node number). MCQ wants the candidates in decreasing order of
+ * degree within the subproblem, so they are sorted by that first,
+ * with the degree inverted above the node number in @keys.
+ */
+static int
+mc_subproblem(struct mcsearch *ms, uint32_t v, const uint32_t *ids, uint32_t k,
+	      uint64_t *keys, uint32_t *loc, uint32_t *buf)
+{
+	const struct FrozenGraph *fg = ms->fg;
+	uint32_t W = (k + 63) / 64;
+
+	ms->k = k;
+	ms->W = W;
+	for (uint32_t i = 0; i < k; ++i) {
+		uint32_t u = ids[i];
+		size_t c = sortedset_intersect_count(ids, k, fg->adj + fg->offset[u], frozen_degree(fg, u));
+		keys[i] = ((uint64_t)(UINT32_MAX - c) << 32) | u;
+	}
+	qsort(keys, k, sizeof(*keys), cmp_u64);
+	for (uint32_t i = 0; i < k; ++i) {
+		ms->sub[i] = (uint32_t)keys[i];
+		loc[ms->sub[i]] = i;
+	}
+
+	memset(ms->adj, 0, (size_t)k * W * sizeof(*ms->adj));
+	for (uint32_t i = 0; i < k; ++i) {
+		uint32_t u = ms->sub[i];
+		uint64_t *row = ms->adj + (size_t)i * W;
+		size_t c = sortedset_intersect(ids, k, fg->adj + fg->offset[u], frozen_degree(fg, u), buf);
+
+		for (size_t j = 0; j < c; ++j) {
+			uint32_t x = loc[buf[j]];
+			row[x / 64] |= UINT64_C(1) << (x % 64);
+		}
+	}
+
+	if (mc_reserve(ms, 0))
+		return -1;
+	memset(ms->P, 0, W * sizeof(*ms->P));
+	for (uint32_t i = 0; i < k; ++i)
+		ms->P[i / 64] |= UINT64_C(1) << (i % 64);
+	ms->R[0] = v;
+	return 0;
+}
+
+ssize_t
+frozen_maximum_clique(const struct FrozenGraph *fg, uint32_t *clique, struct maxclique_stats *stats)
+{
+	uint32_t n = fg->node_count;
+	size_t nn = n ? n : 1, d, dd, wd;
+	struct mcsearch ms;
+	uint32_t *core, *order, *rank, *ids, *loc, *buf;
+	uint64_t *keys;
+	uint64_t subproblems = 0;
+	uint32_t initial;
+	int64_t degeneracy = -1;
+	ssize_t ret = -1;
+
+	if (!(fg->flags & FROZEN_SYMMETRIC)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&ms, 0, sizeof(ms));
+	ms.fg = fg;
+	core = malloc(nn * sizeof(*core));
+	order = malloc(nn * sizeof(*order));
+	rank = malloc(nn * sizeof(*rank));
+	if (core && order && rank)
+		degeneracy = frozen_core_numbers(fg, core, order);
+	if (degeneracy < 0)
+		goto out_core;
+
+	/* No node has more than d later neighbours, and no clique more than d+1 nodes. */
+	d = degeneracy;
+	dd = d ? d : 1;
+	wd = (dd + 63) / 64;
+	ids = malloc(dd * sizeof(*ids));
+	buf = malloc(dd * sizeof(*buf));
+	keys = malloc(dd * sizeof(*keys));
+	loc = malloc(nn * sizeof(*loc));
+	ms.sub = malloc(dd * sizeof(*ms.sub));
+	ms.R = malloc((dd + 1) * sizeof(*ms.R));
+	ms.best = clique;
+	ms.max_k = dd;
+	ms.max_W = wd;
+	ms.adj = malloc(dd * wd * sizeof(*ms.adj));
+	ms.U = malloc(wd * sizeof(*ms.U));
+	ms.Q = malloc(wd * sizeof(*ms.Q));
+	if (!ids || !buf || !keys || !loc || !ms.sub || !ms.R || !ms.adj || !ms.U || !ms.Q)
+		goto out;
+
+	for (uint32_t i = 0; i < n; ++i)
+		rank[order[i]] = i;
+	if (n) {
+		clique[0] = order[0];
+		ms.best_size = 1;
+	}
+
+	/*
+	 * Along a degeneracy order, core numbers never decrease, so
+	 * walking it backwards both loops can stop at the first node
+	 * whose core number rules out beating the current bound.
+	 */
+	for (uint32_t i = n; i-- > 0; ) {
+		if (core[order[i]] + 1 <= ms.best_size)
+			break;
+		greedy_clique(&ms, rank, core, order[i], ids);
+	}
+	initial = ms.best_size;
+
+	for (uint32_t i = n; i-- > 0; ) {
+		uint32_t v = order[i], k;
+
+		if (core[v] + 1 <= ms.best_size)
+			break;
+		k = later_neighbours(fg, rank, core, v, ms.best_size, ids);
+		if (k + 1 <= ms.best_size)
+			continue;
+		subproblems++;
+		if (mc_subproblem(&ms, v, ids, k, keys, loc, buf) || mc_expand(&ms, 0, 1))
+			goto out;
+	}
+
+	if (stats) {
+		stats->subproblems = subproblems;
+		stats->calls = ms.calls;
+		stats->initial = initial;
+	}
+	ret = ms.best_size;
+
+out:
+	free(ids);
+	free(buf);
+	free(keys);
+	free(loc);
+	free(ms.sub);
+	free(ms.R);
+	free(ms.adj);
+	free(ms.U);
+	free(ms.Q);
+	free(ms.P);
+	free(ms.order);
+	free(ms.color);
+out_core:
+	free(core);
+	free(order);
+	free(rank);
+	return ret;
+}
+
+ssize_t
+graph_maximum_clique(const struct Graph *g, const struct Node ***nodes, struct maxclique_stats *stats)
+{
+	struct FrozenGraph fg;
+	uint32_t *clique;
+	const struct Node **res;
+	ssize_t size;
+
+	if (graph_freeze(g, &fg, FROZEN_SYMMETRIC))
+		return -1;
+	clique = malloc((fg.node_count ? fg.node_count : 1) * sizeof(*clique));
+	if (clique == NULL) {
+		frozen_destroy(&fg);
+		return -1;
+	}
+	size = frozen_maximum_clique(&fg, clique, stats);
+	if (size >= 0) {
+		res = malloc((size ? size : 1) * sizeof(*res));
+		if (res == NULL) {
+			size = -1;
+		} else {
+			for (ssize_t j = 0; j < size; ++j)
+				res[j] = fg.nodes[clique[j]];
+			*nodes = res;
+		}
+	}
+	free(clique);
+	frozen_destroy(&fg);
+	return size;
+}
@@ -0,0 +1,67 @@
+#ifndef MAXCLIQUE_H_INCLUDED
+#define MAXCLIQUE_H_INCLUDED
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "graph.h"
+#include "frozen.h"
+
+/*
+ * Maximum clique by branch and bound, in the style of Tomita's MCQ
+ * and San Segundo's bitset variant BBMC.
+ *
+ * The nodes are ordered by degeneracy, and every clique is searched
+ * for from its first node v in that order, among the neighbours of v
+ * later in the order; there are at most d of those, d being the
+ * degeneracy. Each such subproblem is turned into a d x d adjacency
+ * bit matrix, in which the candidate set P of a branch is a row of
+ * words, and intersecting P with a neighbourhood is a word-wise AND.
+ *
+ * Within a branch, P is coloured greedily: a colour class is built by
+ * repeatedly taking the first remaining candidate and removing its
+ * neighbours, so every class is an independent set, and a clique can
+ * use at most one node per class. Branching on the candidates in
+ * decreasing order of colour, the search stops as soon as |R| plus
+ * the colour of the next candidate cannot beat the best clique found.
+ *
+ * Before the exact search, a greedy pass builds a clique from each
+ * node of high core number, which gives an initial lower bound. Since
+ * a clique of size s lies within the (s-1)-core, every node of core
+ * number below the current bound is discarded without branching, and
+ * so is every subproblem with too few candidates.
+ */
+
+struct maxclique_stats {
+	uint64_t  subproblems;  /* nodes v whose subproblem was searched */
+	uint64_t  calls;        /* branches of the search */
+	uint32_t  initial;      /* size of the greedy clique */
+};
+
+/**
+ * frozen_maximum_clique - find a clique of maximum size
+ *
+ * @fg: A frozen graph created with FROZEN_SYMMETRIC
+ * @clique: Array receiving the frozen node numbers of the clique; a
+ *          clique has at most degeneracy + 1 nodes, so fg->node_count
+ *          entries always suffice.
+ * @stats: If non-NULL, receives statistics of the search.
+ *
+ * Returns: The size of the clique (0 only for the empty graph), or -1
+ * on failure (EINVAL if @fg is not symmetric).
+ */
+ssize_t frozen_maximum_clique(const struct FrozenGraph *fg, uint32_t *clique, struct maxclique_stats *stats);
+
+/**
+ * graph_maximum_clique - find a clique of maximum size
+ *
+ * @nodes: Receives a malloc()ed array of the nodes of the clique,
+ *         which the caller must free().
+ *
+ * Direction, loops and parallel edges are ignored.
+ *
+ * Returns: The size of the clique, or -1 on failure.
+ */
+ssize_t graph_maximum_clique(const struct Graph *g, const struct Node ***nodes, struct maxclique_stats *stats);
+
+#endif /* !MAXCLIQUE_H_INCLUDED */
@@ -2,31 +2,64 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <inttypes.h>
 #include <assert.h>
 
 #include <error.h>
 #include <errno.h>
 
 #include <getopt.h>
+#include <pthread.h>
 
 #include <valgrind/valgrind.h>
 
 #include "graph.h"
 #include "clique.h"
+#include "maxclique.h"
+#include "spsc.h"
+#include "percolation.h"
 
 struct optionvalues {
 	long      hashshift;
-	bool      exclude_singletons;    
+	unsigned  min_size;
+	bool      timing;
+	unsigned  progress;
+	unsigned  threads;
+	bool      stats;
+	bool      maximum;
+	bool      count;
+	bool      binary;
+	enum clique_pivot pivot;
+	double    max_seconds;
+	uint64_t  max_calls;
+	uint64_t  max_cliques;
+	const char *checkpoint;
+	const char *resume;
+	uint32_t  *communities;  /* values of k */
+	size_t    ncommunities;
+	const char **query;      /* identifiers of -q */
+	size_t    nquery;
 };
 
 struct optionvalues opt_val = {
-	.exclude_singletons = false,
+	.min_size = 1,
+	.timing = false,
+	.progress = 0,
+	.threads = 1,
+	.stats = false,
+	.maximum = false,
+	.count = false,
+	.binary = false,
+	.pivot = CLIQUE_PIVOT_TOMITA,
 };
 
 static void
 usage(FILE *fp)
 {
-	fputs("maximal_cliques [-x]\n"
+	fputs("maximal_cliques [-x] [-k N] [-t[secs]] [-j N] [-S] [-c] [-b] [--pivot=tomita|degree] [--maximum]\n"
+	      "                [--max-time=SECS] [--max-calls=N] [--max-cliques=N]\n"
+	      "                [--checkpoint=FILE] [--resume=FILE] [--communities=K[,K...]]\n"
+	      "                [-q ID]...\n"
 	      "maximal_cliques -h\n",
 	      fp);
 }
@@ -43,12 +76,96 @@ help(FILE *fp)
 	      "a new string is encountered. If a line contains two fields, that defines an edge\n"
 	      "which is added to the graph.\n"
 	      "\n"
-	      "-x               Do not report singleton cliques (aka isolated nodes)\n"
-	      "-h,--help        print help and exit\n",
+	      "Alternatively, the input can be a binary edge list (see graph.h), which is\n"
+	      "recognized by its magic header and is much faster to load.\n"
+	      "\n"
+	      "-x               Do not report singleton cliques (aka isolated nodes);\n"
+	      "                 the same as -k 2\n"
+	      "-k,--min-size    only report cliques with at least N nodes; the search\n"
+	      "                 skips everything which cannot lead to one, so this is\n"
+	      "                 much faster than filtering the output\n"
+	      "-t,--timing      print throughput and time spent in each phase of loading\n"
+	      "                 the graph to stderr; if secs is given, also print a\n"
+	      "                 progress line every secs seconds, while loading and\n"
+	      "                 while enumerating\n"
+	      "-j,--threads     enumerate cliques using N threads; the cliques are then\n"
+	      "                 printed in no particular order\n"
+	      "-c,--count       do not print the cliques, but for each clique size, the\n"
+	      "                 number of maximal cliques of that size (tab separated)\n"
+	      "-b,--binary      print the cliques in binary (see below)\n"
+	      "-S,--stats       print the number of maximal cliques and of recursive\n"
+	      "                 calls of the search to stderr\n"
+	      "--pivot=RULE     choose pivots maximizing the number of candidates\n"
+	      "                 eliminated (tomita, the default), or by degree (degree);\n"
+	      "                 combine with -S to compare\n"
+	      "--maximum        print only one clique of maximum size, found by branch\n"
+	      "                 and bound; with -S, print statistics of the search\n"
+	      "--max-time=SECS  stop enumerating after SECS seconds\n"
+	      "--max-calls=N    stop after about N recursive calls\n"
+	      "--max-cliques=N  stop after N cliques\n"
+	      "--checkpoint=FILE  regularly (every secs seconds of -t, or 10) write the\n"
+	      "                 position of the search to FILE, from which --resume can\n"
+	      "                 continue; requires -j 1, and does not work with -c\n"
+	      "--resume=FILE    continue from the checkpoint in FILE, appending to the\n"
+	      "                 output of the interrupted run\n"
+	      "--communities=K[,K...]  instead of the cliques, print the communities\n"
+	      "                 of k-clique percolation for each K (see below)\n"
+	      "-q,--query=ID    only print the maximal cliques containing node ID;\n"
+	      "                 may be repeated, for the cliques containing all of\n"
+	      "                 them. Only their common neighbours are searched, so\n"
+	      "                 this is fast even in graphs too large to enumerate;\n"
+	      "                 -j and the budgets do not apply\n"
+	      "-h,--help        print help and exit\n"
+	      "\n"
+	      "When a budget runs out, the exit status is 3. The cliques are always\n"
+	      "found in the same order, and a resumed run numbers them as the original\n"
+	      "one would have. It may print the last few cliques before the checkpoint\n"
+	      "again, with the same numbers.\n"
+	      "\n"
+	      "A k-clique community is the union of the cliques of k nodes which can\n"
+	      "be reached from one another through cliques sharing k-1 nodes; the\n"
+	      "communities may overlap. They are found in a single pass over the\n"
+	      "maximal cliques, for all K at once, and printed as lines of K, the\n"
+	      "number of the community, and a node, tab separated.\n"
+	      "\n"
+	      "The binary output starts with a 16 byte header: the magic \"\\x89RVC\",\n"
+	      "a version byte (1), the width of node indices (4), two zero bytes, and\n"
+	      "the number of nodes as a 64 bit integer. Then follow the identifiers of\n"
+	      "the nodes, nul-terminated, in the order they appear in the input; node\n"
+	      "index i refers to the i'th of those. Each clique is then a 64 bit\n"
+	      "clique number, a 32 bit node count, and that many 32 bit node indices.\n"
+	      "All integers are in host byte order.\n",
 	      fp);
 }
 
 
+/* Parse a comma separated list of values of k, each at least 2. */
+static void
+parse_communities(const char *arg)
+{
+	size_t n = 1;
+
+	for (const char *p = arg; *p; ++p)
+		n += *p == ',';
+	opt_val.communities = malloc(n * sizeof(*opt_val.communities));
+	if (opt_val.communities == NULL)
+		error(2, errno, "malloc()");
+	opt_val.ncommunities = 0;
+	while (1) {
+		char *end;
+		unsigned long k = strtoul(arg, &end, 10);
+
+		if (end == arg || k < 2 || k > UINT32_MAX || (*end && *end != ',')) {
+			usage(stderr);
+			exit(1);
+		}
+		opt_val.communities[opt_val.ncommunities++] = k;
+		if (*end == '\0')
+			break;
+		arg = end + 1;
+	}
+}
+
 static void
 parse_options(int argc, char *argv[])
 {
@@ -56,12 +173,27 @@ parse_options(int argc, char *argv[])
 		static struct option Options[] = {
 			{"help",       no_argument, 0, 'h'},
 			{"exclude-singletons", no_argument, 0, 'x'},
+			{"min-size",   required_argument, 0, 'k'},
+			{"timing",     optional_argument, 0, 't'},
+			{"threads",    required_argument, 0, 'j'},
+			{"stats",      no_argument, 0, 'S'},
+			{"count",      no_argument, 0, 'c'},
+			{"binary",     no_argument, 0, 'b'},
+			{"max-time",   required_argument, 0, 'T'},
+			{"max-calls",  required_argument, 0, 'C'},
+			{"max-cliques", required_argument, 0, 'Q'},
+			{"checkpoint", required_argument, 0, 'K'},
+			{"resume",     required_argument, 0, 'R'},
+			{"pivot",      required_argument, 0, 'P'},
+			{"maximum",    no_argument, 0, 'M'},
+			{"communities", required_argument, 0, 'G'},
+			{"query",      required_argument, 0, 'q'},
 			{0, 0, 0, 0},
 		};
 		int option_index = 0;
 		int c;
 
-		c = getopt_long(argc, argv, "xh", Options, &option_index);
+		c = getopt_long(argc, argv, "xk:t::j:Scbq:h", Options, &option_index);
 		if (c == -1)
 			break;
 		switch(c) {
@@ -70,7 +202,69 @@ parse_options(int argc, char *argv[])
 			exit(0);
 			break;
 		case 'x':
-			opt_val.exclude_singletons = true;
+			if (opt_val.min_size < 2)
+				opt_val.min_size = 2;
+			break;
+		case 'k':
+			opt_val.min_size = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			opt_val.timing = true;
+			if (optarg)
+				opt_val.progress = strtoul(optarg, NULL, 10);
+			break;
+		case 'j':
+			opt_val.threads = strtoul(optarg, NULL, 10);
+			if (opt_val.threads == 0) {
+				usage(stderr);
+				exit(1);
+			}
+			break;
+		case 'S':
+			opt_val.stats = true;
+			break;
+		case 'c':
+			opt_val.count = true;
+			break;
+		case 'b':
+			opt_val.binary = true;
+			break;
+		case 'T':
+			opt_val.max_seconds = strtod(optarg, NULL);
+			break;
+		case 'C':
+			opt_val.max_calls = strtoull(optarg, NULL, 10);
+			break;
+		case 'Q':
+			opt_val.max_cliques = strtoull(optarg, NULL, 10);
+			break;
+		case 'K':
+			opt_val.checkpoint = optarg;
+			break;
+		case 'R':
+			opt_val.resume = optarg;
+			break;
+		case 'P':
+			if (!strcmp(optarg, "tomita"))
+				opt_val.pivot = CLIQUE_PIVOT_TOMITA;
+			else if (!strcmp(optarg, "degree"))
+				opt_val.pivot = CLIQUE_PIVOT_DEGREE;
+			else {
+				usage(stderr);
+				exit(1);
+			}
+			break;
+		case 'M':
+			opt_val.maximum = true;
+			break;
+		case 'G':
+			parse_communities(optarg);
+			break;
+		case 'q':
+			opt_val.query = realloc(opt_val.query, (opt_val.nquery + 1) * sizeof(*opt_val.query));
+			if (opt_val.query == NULL)
+				error(2, errno, "realloc()");
+			opt_val.query[opt_val.nquery++] = optarg;
 			break;
 		case '?':
 			usage(stderr);
@@ -80,45 +274,422 @@ parse_options(int argc, char *argv[])
 			assert(0);
 		}
 	}
+	/* The counts are only printed at the end, so a killed -c run has nothing to resume. */
+	if ((opt_val.checkpoint && opt_val.threads > 1) ||
+	    (opt_val.count && (opt_val.checkpoint || opt_val.resume))) {
+		usage(stderr);
+		exit(1);
+	}
+	if (opt_val.communities && (opt_val.count || opt_val.binary || opt_val.maximum ||
+				    opt_val.checkpoint || opt_val.resume)) {
+		usage(stderr);
+		exit(1);
+	}
+	if (opt_val.query && (opt_val.count || opt_val.maximum || opt_val.communities || opt_val.stats ||
+			      opt_val.checkpoint || opt_val.resume)) {
+		usage(stderr);
+		exit(1);
+	}
 }
 
-struct context {
-	unsigned long index;
+/*
+ * Output is done by a separate thread, so that the enumeration does
+ * not stall on a slow stdout (such as a pipe to a compressor). The
+ * callback passes each clique through a ring buffer (see spsc.h) as
+ * its node count followed by the node pointers; the writer numbers
+ * the cliques, formats them into a large buffer, and writes that out
+ * in bulk. The callbacks are serialized, so there is a single
+ * producer.
+ *
+ * A count of zero is a sync marker: the writer flushes everything
+ * before it, and acknowledges in syncs_done. This is how checkpoints
+ * make sure that the cliques before them are in the output.
+ */
+#define RING_SIZE    (1 << 16)
+#define OUTBUF_SIZE  (1 << 16)
+
+struct writer {
+	struct spsc  ring;
+	pthread_t    tid;
+	FILE         *fp;
+	int          err;      /* errno of the first failed write */
+	char         *buf;
+	size_t       len;
+	uint64_t     first_id; /* the number of the first clique, minus one */
+	uint64_t     syncs_requested, syncs_done;
 };
 
+static void
+writer_flush(struct writer *wr)
+{
+	if (wr->len && !wr->err && fwrite(wr->buf, 1, wr->len, wr->fp) != wr->len)
+		wr->err = errno ? errno : EIO;
+	wr->len = 0;
+}
+
+/* Append to the output buffer; after a write error, everything is dropped. */
+static void
+writer_put(struct writer *wr, const void *data, size_t len)
+{
+	if (wr->len + len > OUTBUF_SIZE)
+		writer_flush(wr);
+	if (len > OUTBUF_SIZE) {
+		if (!wr->err && fwrite(data, 1, len, wr->fp) != len)
+			wr->err = errno ? errno : EIO;
+		return;
+	}
+	memcpy(wr->buf + wr->len, data, len);
+	wr->len += len;
+}
+
+static void *
+writer_main(void *arg)
+{
+	struct writer *wr = arg;
+	uintptr_t words[4096];
+	uint64_t id = wr->first_id, remaining = 0;
+	char idstr[24];
+	size_t idlen = 0, n;
+
+	while ((n = spsc_read(&wr->ring, words, sizeof(words)/sizeof(words[0]))) > 0) {
+		for (size_t i = 0; i < n; ++i) {
+			const struct Node *node;
+
+			if (remaining == 0) {
+				uint32_t count = words[i];
+				if (count == 0) {
+					writer_flush(wr);
+					if (!wr->err && fflush(wr->fp))
+						wr->err = errno;
+					__atomic_store_n(&wr->syncs_done, wr->syncs_done + 1, __ATOMIC_RELEASE);
+					continue;
+				}
+				remaining = count;
+				id++;
+				if (opt_val.binary) {
+					writer_put(wr, &id, sizeof(id));
+					writer_put(wr, &count, sizeof(count));
+				} else {
+					idlen = snprintf(idstr, sizeof(idstr), "%" PRIu64 "\t", id);
+				}
+				continue;
+			}
+			node = (const struct Node *)words[i];
+			remaining--;
+			if (opt_val.binary) {
+				writer_put(wr, &node->index, sizeof(node->index));
+			} else {
+				writer_put(wr, idstr, idlen);
+				writer_put(wr, node->ident, strlen(node->ident));
+				writer_put(wr, "\n", 1);
+			}
+		}
+	}
+	writer_flush(wr);
+	if (!wr->err && fflush(wr->fp))
+		wr->err = errno;
+	return NULL;
+}
+
+static int
+collect_node(const struct Node *node, void *ctx)
+{
+	const struct Node **byindex = ctx;
+	byindex[node->index] = node;
+	return 0;
+}
+
+static int
+collect_component(const struct Component *comp, void *ctx)
+{
+	return component_iterate_nodes(comp, collect_node, ctx);
+}
+
+static void
+write_binary_header(struct writer *wr, const struct Graph *gph)
+{
+	unsigned char hdr[16] = "\x89RVC\x01\x04";
+	uint64_t count = gph->node_count;
+	const struct Node **byindex = calloc(count ? count : 1, sizeof(*byindex));
+
+	if (byindex == NULL)
+		error(2, errno, "malloc()");
+	graph_iterate_components(gph, collect_component, byindex);
+	memcpy(hdr + 8, &count, sizeof(count));
+	writer_put(wr, hdr, sizeof(hdr));
+	for (uint64_t i = 0; i < count; ++i) {
+		const char *ident = byindex[i] ? byindex[i]->ident : "";
+		writer_put(wr, ident, strlen(ident) + 1);
+	}
+	free(byindex);
+}
+
+static void
+writer_start(struct writer *wr, const struct Graph *gph, uint64_t first_id)
+{
+	memset(wr, 0, sizeof(*wr));
+	wr->fp = stdout;
+	wr->first_id = first_id;
+	wr->buf = malloc(OUTBUF_SIZE);
+	if (wr->buf == NULL || spsc_init(&wr->ring, RING_SIZE))
+		error(2, errno, "malloc()");
+	/* A resumed run appends to the output which already has the header. */
+	if (opt_val.binary && !opt_val.resume)
+		write_binary_header(wr, gph);
+	errno = pthread_create(&wr->tid, NULL, writer_main, wr);
+	if (errno)
+		error(2, errno, "pthread_create()");
+}
+
+/* Wait until everything passed to the writer so far has been written. */
+static void
+writer_sync(struct writer *wr)
+{
+	uintptr_t marker = 0;
+	uint64_t want = ++wr->syncs_requested;
+
+	spsc_write(&wr->ring, &marker, 1);
+	while (__atomic_load_n(&wr->syncs_done, __ATOMIC_ACQUIRE) < want)
+		nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = 100000 }, NULL);
+	if (wr->err)
+		error(2, wr->err, "writing output failed");
+}
+
+static void
+writer_finish(struct writer *wr)
+{
+	spsc_close(&wr->ring);
+	pthread_join(wr->tid, NULL);
+	if (wr->err)
+		error(2, wr->err, "writing output failed");
+	spsc_destroy(&wr->ring);
+	free(wr->buf);
+}
 
 static int
 print_clique_cb(const struct Node **nodes, size_t count, void *ctx)
 {
-	struct context *context = ctx;
-	size_t i;
+	struct writer *wr = ctx;
+	uintptr_t words[256];
+	size_t i, n = 0;
 
 	if (count == 0) /* Shouldn't happen, but just in case. */
 		return 0;
-	if (opt_val.exclude_singletons && count == 1)
+	if (count < opt_val.min_size)
 		return 0;
 
-	context->index++;
+	words[n++] = count;
 	for (i = 0; i < count; ++i) {
-		fprintf(stdout, "%lu\t%s\n", context->index, nodes[i]->ident);
+		if (n == sizeof(words)/sizeof(words[0])) {
+			spsc_write(&wr->ring, words, n);
+			n = 0;
+		}
+		words[n++] = (uintptr_t)nodes[i];
+	}
+	spsc_write(&wr->ring, words, n);
+	return 0;
+}
+
+/*
+ * A checkpoint is a line "component branch cliques": where to resume
+ * (see struct clique_position), and the number of cliques printed
+ * before that. It is written to a temporary file which is then
+ * renamed, so a run killed while writing one leaves the previous.
+ */
+struct progress_ctx {
+	struct writer  *wr;      /* NULL when not printing cliques */
+	uint64_t       first_id;
+};
+
+static void
+write_checkpoint(const struct clique_position *pos, uint64_t cliques)
+{
+	size_t len = strlen(opt_val.checkpoint);
+	char *tmp = malloc(len + 5);
+	FILE *fp;
+
+	if (tmp == NULL)
+		error(2, errno, "malloc()");
+	memcpy(tmp, opt_val.checkpoint, len);
+	memcpy(tmp + len, ".tmp", 5);
+	fp = fopen(tmp, "w");
+	if (fp == NULL)
+		error(2, errno, "could not open '%s' for writing", tmp);
+	fprintf(fp, "%" PRIu32 " %" PRIu32 " %" PRIu64 "\n", pos->component, pos->branch, cliques);
+	if (fclose(fp) || rename(tmp, opt_val.checkpoint))
+		error(2, errno, "writing checkpoint '%s' failed", opt_val.checkpoint);
+	free(tmp);
+}
+
+static void
+read_checkpoint(const char *filename, struct clique_position *pos, uint64_t *cliques)
+{
+	FILE *fp = fopen(filename, "r");
+
+	if (fp == NULL)
+		error(2, errno, "could not open '%s'", filename);
+	if (fscanf(fp, "%" SCNu32 " %" SCNu32 " %" SCNu64, &pos->component, &pos->branch, cliques) != 3)
+		error(2, 0, "malformed checkpoint '%s'", filename);
+	fclose(fp);
+}
+
+static void
+progress_cb(const struct clique_progress *p, void *ctx)
+{
+	struct progress_ctx *pc = ctx;
+
+	if (opt_val.progress)
+		fprintf(stderr, "%.1fs: %" PRIu64 " cliques, %.0f calls/s, component %" PRIu32 ", branch %" PRIu32 "/%" PRIu32 "\n",
+			p->elapsed, p->cliques, p->elapsed > 0 ? p->calls / p->elapsed : 0.0,
+			p->pos.component, p->pos.branch, p->branches);
+	if (opt_val.checkpoint) {
+		if (pc->wr)
+			writer_sync(pc->wr);
+		write_checkpoint(&p->pos, pc->first_id + p->cliques_before);
+	}
+}
+
+struct community_counter {
+	uint32_t  k;
+	uint64_t  id;
+};
+
+static int
+print_community_cb(uint32_t k, const struct Node **nodes, size_t count, void *ctx)
+{
+	struct community_counter *cc = ctx;
+
+	if (cc->k != k) {
+		cc->k = k;
+		cc->id = 0;
 	}
+	cc->id++;
+	for (size_t i = 0; i < count; ++i)
+		fprintf(stdout, "%" PRIu32 "\t%" PRIu64 "\t%s\n", k, cc->id, nodes[i]->ident);
 	return 0;
 }
 
 int main(int argc, char *argv[]) {
 	struct Graph gph;
-	unsigned flags = GRAPH_NOLOOP | GRAPH_NOPARALLEL | GRAPH_DUAL;
-	struct context ctx = { .index = 0 };
+	unsigned flags = GRAPH_UNDIRECTED | GRAPH_NOLOOP | GRAPH_NOPARALLEL;
+	struct writer wr;
+	struct graph_loadstats ls;
+	struct clique_options copt = { 0 };
+	struct clique_stats cstats;
+	void *ctxs[1] = { &wr };
+	struct progress_ctx pctx = { .wr = NULL, .first_id = 0 };
+	bool exhausted = false;
+	int ret, err;
 
 	parse_options(argc, argv);
 
 	if (graph_init(&gph, flags))
 		error(2, errno, "initialization failed");
 
+	if (opt_val.timing) {
+		graph_loadstats_init(&ls, opt_val.progress);
+		graph_set_loadstats(&gph, &ls);
+	}
+
 	if (graph_add_file(&gph, stdin))
 		error(2, errno, "reading graph failed");
 
-	graph_iterate_maximal_cliques(&gph, print_clique_cb, &ctx);
+	if (opt_val.timing) {
+		graph_loadstats_print(&ls, &gph, stderr);
+		graph_set_loadstats(&gph, NULL);
+	}
+
+	if (opt_val.maximum) {
+		const struct Node **nodes;
+		struct maxclique_stats mstats;
+		ssize_t size = graph_maximum_clique(&gph, &nodes, &mstats);
+
+		if (size < 0)
+			error(2, errno, "finding a maximum clique failed");
+		writer_start(&wr, &gph, 0);
+		print_clique_cb(nodes, size, &wr);
+		writer_finish(&wr);
+		if (opt_val.stats)
+			fprintf(stderr, "maximum clique of size %zd (greedy bound %" PRIu32 "), %" PRIu64 " subproblems, %" PRIu64 " branches\n",
+				size, mstats.initial, mstats.subproblems, mstats.calls);
+		free(nodes);
+		if (RUNNING_ON_VALGRIND)
+			graph_destroy(&gph);
+		return 0;
+	}
+
+	if (opt_val.query) {
+		const struct Node **nodes = malloc(opt_val.nquery * sizeof(*nodes));
+
+		if (nodes == NULL)
+			error(2, errno, "malloc()");
+		for (size_t i = 0; i < opt_val.nquery; ++i) {
+			nodes[i] = graph_find_node(&gph, opt_val.query[i]);
+			if (nodes[i] == NULL)
+				error(2, 0, "unknown node '%s'", opt_val.query[i]);
+		}
+		writer_start(&wr, &gph, 0);
+		ret = graph_iterate_cliques_containing(&gph, nodes, opt_val.nquery, print_clique_cb, &wr);
+		err = errno;
+		writer_finish(&wr);
+		if (ret)
+			error(2, err, "enumerating cliques failed");
+		free(nodes);
+		if (RUNNING_ON_VALGRIND)
+			graph_destroy(&gph);
+		return 0;
+	}
+
+	copt.threads = opt_val.threads;
+	copt.serialize = true;
+	copt.pivot = opt_val.pivot;
+	copt.min_size = opt_val.min_size;
+	copt.stats = opt_val.stats ? &cstats : NULL;
+	copt.max_seconds = opt_val.max_seconds;
+	copt.max_calls = opt_val.max_calls;
+	copt.max_cliques = opt_val.max_cliques;
+	if (opt_val.progress || opt_val.checkpoint) {
+		copt.progress = progress_cb;
+		copt.progress_ctx = &pctx;
+		copt.progress_interval = opt_val.progress ? opt_val.progress : 10;
+	}
+	if (opt_val.resume)
+		read_checkpoint(opt_val.resume, &copt.resume, &pctx.first_id);
+
+	if (opt_val.communities) {
+		struct community_counter cc = { 0 };
+
+		ret = graph_clique_percolation(&gph, opt_val.communities, opt_val.ncommunities, &copt,
+					       print_community_cb, &cc);
+		if (ret && errno != ETIMEDOUT)
+			error(2, errno, "finding communities failed");
+		exhausted = ret != 0;
+	} else if (opt_val.count) {
+		struct clique_counts counts;
+
+		ret = graph_count_maximal_cliques(&gph, &copt, &counts);
+		if (ret && errno != ETIMEDOUT)
+			error(2, errno, "counting cliques failed");
+		exhausted = ret != 0;
+		for (uint32_t s = 0; s <= counts.max_size; ++s) {
+			if (counts.by_size[s])
+				fprintf(stdout, "%" PRIu32 "\t%" PRIu64 "\n", s, counts.by_size[s]);
+		}
+		free(counts.by_size);
+	} else {
+		writer_start(&wr, &gph, pctx.first_id);
+		pctx.wr = &wr;
+		ret = graph_iterate_maximal_cliques_opt(&gph, &copt, print_clique_cb, ctxs);
+		err = errno;
+		writer_finish(&wr);
+		if (ret && err != ETIMEDOUT)
+			error(2, err, "enumerating cliques failed");
+		exhausted = ret != 0;
+	}
+	if (opt_val.stats)
+		fprintf(stderr, "%" PRIu64 " maximal cliques, %" PRIu64 " recursive calls\n", cstats.cliques, cstats.calls);
+	if (exhausted)
+		error(3, 0, "budget exhausted, stopping");
 
 	if (RUNNING_ON_VALGRIND)
 		graph_destroy(&gph);
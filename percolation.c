@@ -0,0 +1,511 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "graph.h"
+#include "clique.h"
+#include "jenkins_hash.h"
+#include "percolation.h"
+
+#define NONE UINT32_MAX
+
+static int
+cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+void
+percolation_destroy(struct percolation *pc)
+{
+	if (pc->parent) {
+		for (uint32_t j = 0; j < pc->nk; ++j)
+			free(pc->parent[j]);
+	}
+	if (pc->subsets) {
+		for (uint32_t j = 0; j < pc->nk; ++j)
+			free(pc->subsets[j].slots);
+	}
+	free(pc->parent);
+	free(pc->subsets);
+	free(pc->subset);
+	free(pc->ks);
+	free(pc->nodes);
+	free(pc->start);
+	free(pc->overlap);
+	free(pc->touched);
+	free(pc->member);
+	free(pc->owner);
+	free(pc->next);
+	free(pc->lnext);
+	free(pc->head);
+	free(pc->lhead);
+	free(pc->ncliques);
+	memset(pc, 0, sizeof(*pc));
+}
+
+int
+percolation_init(struct percolation *pc, const struct Graph *g, const uint32_t *ks, size_t nk)
+{
+	size_t nn = g->node_count ? g->node_count : 1;
+
+	memset(pc, 0, sizeof(*pc));
+	pc->ks = malloc((nk ? nk : 1) * sizeof(*pc->ks));
+	if (pc->ks == NULL)
+		return -1;
+	for (size_t j = 0; j < nk; ++j) {
+		if (ks[j] >= 2)
+			pc->ks[pc->nk++] = ks[j];
+	}
+	if (pc->nk == 0) {
+		percolation_destroy(pc);
+		errno = EINVAL;
+		return -1;
+	}
+	qsort(pc->ks, pc->nk, sizeof(*pc->ks), cmp_u32);
+	nk = pc->nk;
+	pc->nk = 1;
+	for (size_t j = 1; j < nk; ++j) {
+		if (pc->ks[j] != pc->ks[pc->nk-1])
+			pc->ks[pc->nk++] = pc->ks[j];
+	}
+
+	pc->node_count = g->node_count;
+	pc->nodes = calloc(nn, sizeof(*pc->nodes));
+	pc->head = malloc(nn * sizeof(*pc->head));
+	pc->lhead = malloc(nn * sizeof(*pc->lhead));
+	pc->ncliques = calloc(nn, sizeof(*pc->ncliques));
+	pc->start = malloc(sizeof(*pc->start));
+	pc->parent = calloc(pc->nk, sizeof(*pc->parent));
+	pc->subsets = calloc(pc->nk, sizeof(*pc->subsets));
+	pc->subset = malloc(pc->ks[pc->nk-1] * sizeof(*pc->subset));
+	if (!pc->nodes || !pc->head || !pc->lhead || !pc->ncliques || !pc->start || !pc->parent || !pc->subsets || !pc->subset) {
+		percolation_destroy(pc);
+		return -1;
+	}
+	memset(pc->head, 0xff, nn * sizeof(*pc->head));
+	memset(pc->lhead, 0xff, nn * sizeof(*pc->lhead));
+	pc->start[0] = 0;
+	return 0;
+}
+
+/* Make room for one more clique. */
+static int
+reserve_clique(struct percolation *pc)
+{
+	uint32_t cap = pc->cliques_cap;
+	uint64_t *start;
+	uint32_t *overlap, *touched;
+
+	if (pc->cliques < cap)
+		return 0;
+	if (cap == NONE - 1) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+	cap = cap ? (cap < (NONE - 1) / 2 ? 2 * cap : NONE - 1) : 1024;
+	start = realloc(pc->start, ((size_t)cap + 1) * sizeof(*start));
+	if (!start)
+		return -1;
+	pc->start = start;
+	overlap = realloc(pc->overlap, cap * sizeof(*overlap));
+	if (!overlap)
+		return -1;
+	/* Only the new part needs clearing; the rest is kept at zero. */
+	memset(overlap + pc->cliques_cap, 0, (cap - pc->cliques_cap) * sizeof(*overlap));
+	pc->overlap = overlap;
+	touched = realloc(pc->touched, cap * sizeof(*touched));
+	if (!touched)
+		return -1;
+	pc->touched = touched;
+	for (uint32_t j = 0; j < pc->nk; ++j) {
+		uint32_t *parent = realloc(pc->parent[j], cap * sizeof(*parent));
+		if (!parent)
+			return -1;
+		pc->parent[j] = parent;
+	}
+	pc->cliques_cap = cap;
+	return 0;
+}
+
+/* Make room for count more memberships. */
+static int
+reserve_members(struct percolation *pc, size_t count)
+{
+	uint64_t need = (uint64_t)pc->members + count;
+	uint64_t cap = pc->members_cap;
+	uint32_t *member, *owner, *next, *lnext;
+
+	if (need <= cap)
+		return 0;
+	if (need >= NONE) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+	cap = cap ? 2 * cap : 4096;
+	if (cap < need)
+		cap = need;
+	if (cap >= NONE)
+		cap = NONE - 1;
+	member = realloc(pc->member, cap * sizeof(*member));
+	if (member)
+		pc->member = member;
+	owner = realloc(pc->owner, cap * sizeof(*owner));
+	if (owner)
+		pc->owner = owner;
+	next = realloc(pc->next, cap * sizeof(*next));
+	if (next)
+		pc->next = next;
+	lnext = realloc(pc->lnext, cap * sizeof(*lnext));
+	if (lnext)
+		pc->lnext = lnext;
+	if (!member || !owner || !next || !lnext)
+		return -1;
+	pc->members_cap = cap;
+	return 0;
+}
+
+/* Find the root of c, halving the path on the way. */
+static uint32_t
+uf_find(uint32_t *parent, uint32_t c)
+{
+	while (parent[c] != c) {
+		parent[c] = parent[parent[c]];
+		c = parent[c];
+	}
+	return c;
+}
+
+/* The root is always the earliest clique of the class. */
+static void
+uf_union(uint32_t *parent, uint32_t a, uint32_t b)
+{
+	a = uf_find(parent, a);
+	b = uf_find(parent, b);
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+static inline uint32_t
+clique_size(const struct percolation *pc, uint32_t c)
+{
+	return pc->start[c+1] - pc->start[c];
+}
+
+/* C(n, r), or limit + 1 if it is more than limit. */
+static uint64_t
+binomial(uint32_t n, uint32_t r, uint64_t limit)
+{
+	uint64_t b = 1;
+
+	if (r > n - r)
+		r = n - r;
+	for (uint32_t i = 1; i <= r; ++i) {
+		/* b * (n - r + i) / i is C(n - r + i, i), an integer. */
+		b = b * (n - r + i) / i;
+		if (b > limit)
+			return limit + 1;
+	}
+	return b;
+}
+
+/*
+ * Whether the new clique c is counted rather than hashed (see
+ * percolation.h): counting costs the number of earlier cliques of
+ * its nodes.
+ */
+static bool
+is_large(const struct percolation *pc, uint32_t c)
+{
+	const uint32_t *cm = pc->member + pc->start[c];
+	uint32_t size = clique_size(pc, c);
+	uint64_t limit = 0;
+
+	if (size > 63)
+		return true;
+	for (uint32_t i = 0; i < size; ++i)
+		limit += pc->ncliques[cm[i]];
+	if (limit < PERCOLATION_SUBSETS)
+		limit = PERCOLATION_SUBSETS;
+	for (uint32_t j = 0; j < pc->nk && pc->ks[j] <= size; ++j) {
+		if (binomial(size, pc->ks[j] - 1, limit) > limit)
+			return true;
+	}
+	return false;
+}
+
+static int
+subset_grow(struct subset_table *t)
+{
+	uint64_t size = t->slots ? 2 * ((uint64_t)t->mask + 1) : 1024;
+	struct subset_entry *slots;
+
+	/* The slots are numbered by uint32_t (and hashed to 32 bits). */
+	if (size > (uint64_t)UINT32_MAX + 1 || size > SIZE_MAX / sizeof(*slots)) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+	slots = malloc(size * sizeof(*slots));
+	if (slots == NULL)
+		return -1;
+	for (uint64_t i = 0; i < size; ++i)
+		slots[i].clique = NONE;
+	for (uint64_t i = 0; t->slots && i <= t->mask; ++i) {
+		uint64_t h = t->slots[i].hash & (size - 1);
+
+		if (t->slots[i].clique == NONE)
+			continue;
+		while (slots[h].clique != NONE)
+			h = (h + 1) & (size - 1);
+		slots[h] = t->slots[i];
+	}
+	free(t->slots);
+	t->slots = slots;
+	t->mask = size - 1;
+	return 0;
+}
+
+/*
+ * Look up the subset of clique c at the positions in mask. If an
+ * earlier clique has it, return that; otherwise, record that c has it
+ * and return c.
+ */
+static int64_t
+subset_lookup(struct percolation *pc, struct subset_table *t, uint32_t c, uint64_t mask, uint32_t r)
+{
+	const uint32_t *cm = pc->member + pc->start[c];
+	uint32_t *sub = pc->subset, h, i = 0;
+
+	if (((uint64_t)t->count + 1) * 2 > (uint64_t)t->mask + 1 && subset_grow(t))
+		return -1;
+	for (uint64_t m = mask; m; m &= m - 1)
+		sub[i++] = cm[__builtin_ctzll(m)];
+	h = jenkins_hashword(sub, r, 0);
+	for (uint32_t s = h & t->mask; ; s = (s + 1) & t->mask) {
+		struct subset_entry *e = &t->slots[s];
+		const uint32_t *dm;
+
+		if (e->clique == NONE) {
+			e->hash = h;
+			e->clique = c;
+			e->subset = mask;
+			t->count++;
+			return c;
+		}
+		if (e->hash != h)
+			continue;
+		dm = pc->member + pc->start[e->clique];
+		i = 0;
+		for (uint64_t m = e->subset; m && dm[__builtin_ctzll(m)] == sub[i]; m &= m - 1)
+			i++;
+		if (i == r)
+			return e->clique;
+	}
+}
+
+/* Count the overlaps of c with the earlier cliques in the given lists, and unite. */
+static void
+count_overlaps(struct percolation *pc, uint32_t c, const uint32_t *head, const uint32_t *next)
+{
+	const uint32_t *cm = pc->member + pc->start[c];
+	uint32_t count = clique_size(pc, c), ntouched = 0;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		for (uint32_t e = head[cm[i]]; e != NONE; e = next[e]) {
+			uint32_t d = pc->owner[e];
+			if (pc->overlap[d]++ == 0)
+				pc->touched[ntouched++] = d;
+		}
+	}
+	for (uint32_t t = 0; t < ntouched; ++t) {
+		uint32_t d = pc->touched[t];
+		uint32_t kmax = pc->overlap[d] + 1;
+
+		pc->overlap[d] = 0;
+		if (kmax > count)
+			kmax = count;
+		if (kmax > clique_size(pc, d))
+			kmax = clique_size(pc, d);
+		for (uint32_t j = 0; j < pc->nk && pc->ks[j] <= kmax; ++j)
+			uf_union(pc->parent[j], c, d);
+	}
+}
+
+int
+percolation_add_clique(const struct Node **nodes, size_t count, void *ctx)
+{
+	struct percolation *pc = ctx;
+	uint32_t c = pc->cliques, *cm;
+	uint64_t first = pc->members;
+	bool large;
+
+	if (count < pc->ks[0])
+		return 0;
+	if (reserve_clique(pc) || reserve_members(pc, count))
+		return -1;
+
+	cm = pc->member + first;
+	for (size_t i = 0; i < count; ++i) {
+		cm[i] = nodes[i]->index;
+		pc->nodes[cm[i]] = nodes[i];
+	}
+	qsort(cm, count, sizeof(*cm), cmp_u32);
+	pc->start[c+1] = first + count;
+	for (uint32_t j = 0; j < pc->nk; ++j)
+		pc->parent[j][c] = c;
+
+	large = is_large(pc, c);
+	if (large) {
+		count_overlaps(pc, c, pc->head, pc->next);
+	} else {
+		count_overlaps(pc, c, pc->lhead, pc->lnext);
+		for (uint32_t j = 0; j < pc->nk && pc->ks[j] <= count; ++j) {
+			uint32_t r = pc->ks[j] - 1;
+
+			/* All r-subsets, as masks in increasing order (Gosper's hack). */
+			for (uint64_t m = (1ULL << r) - 1; m < 1ULL << count; ) {
+				uint64_t low = m & -m, up = m + low;
+				int64_t d = subset_lookup(pc, &pc->subsets[j], c, m, r);
+
+				if (d < 0)
+					return -1;
+				uf_union(pc->parent[j], c, d);
+				m = up | (((m ^ up) >> 2) / low);
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t u = cm[i], e = first + i;
+
+		pc->owner[e] = c;
+		pc->ncliques[u]++;
+		pc->next[e] = pc->head[u];
+		pc->head[u] = e;
+		if (large) {
+			pc->lnext[e] = pc->lhead[u];
+			pc->lhead[u] = e;
+		}
+	}
+	pc->members += count;
+	pc->cliques++;
+	return 0;
+}
+
+/*
+ * The cliques of each class are chained through link, from the root
+ * (the earliest clique) on, so the classes come out in order of their
+ * first clique; a stamp per node removes the duplicates from the
+ * union of the cliques.
+ */
+int
+percolation_communities(struct percolation *pc, uint32_t k,
+			int (*cb)(const struct Node **nodes, size_t count, void *ctx), void *ctx)
+{
+	uint32_t j, n = pc->cliques;
+	size_t nc = n ? n : 1, nn = pc->node_count ? pc->node_count : 1;
+	uint32_t *link = NULL, *tail = NULL, *stamp = NULL, *idx = NULL;
+	const struct Node **out = NULL;
+	int ret = -1;
+
+	for (j = 0; j < pc->nk && pc->ks[j] != k; ++j)
+		;
+	if (j == pc->nk) {
+		errno = EINVAL;
+		return -1;
+	}
+	link = malloc(nc * sizeof(*link));
+	tail = malloc(nc * sizeof(*tail));
+	stamp = malloc(nn * sizeof(*stamp));
+	idx = malloc(nn * sizeof(*idx));
+	out = malloc(nn * sizeof(*out));
+	if (!link || !tail || !stamp || !idx || !out)
+		goto out;
+	memset(stamp, 0xff, nn * sizeof(*stamp));
+
+	for (uint32_t c = 0; c < n; ++c) {
+		uint32_t r;
+
+		link[c] = NONE;
+		if (clique_size(pc, c) < k)
+			continue;
+		r = uf_find(pc->parent[j], c);
+		if (r != c)
+			link[tail[r]] = c;
+		tail[r] = c;
+	}
+
+	ret = 0;
+	for (uint32_t r = 0; r < n && ret == 0; ++r) {
+		uint32_t len = 0;
+
+		if (clique_size(pc, r) < k || pc->parent[j][r] != r)
+			continue;
+		for (uint32_t c = r; c != NONE; c = link[c]) {
+			for (uint64_t e = pc->start[c]; e < pc->start[c+1]; ++e) {
+				uint32_t u = pc->member[e];
+				if (stamp[u] != r) {
+					stamp[u] = r;
+					idx[len++] = u;
+				}
+			}
+		}
+		qsort(idx, len, sizeof(*idx), cmp_u32);
+		for (uint32_t i = 0; i < len; ++i)
+			out[i] = pc->nodes[idx[i]];
+		ret = (*cb)(out, len, ctx);
+	}
+
+out:
+	free(link);
+	free(tail);
+	free(stamp);
+	free(idx);
+	free(out);
+	return ret;
+}
+
+struct community_ctx {
+	int (*cb)(uint32_t k, const struct Node **nodes, size_t count, void *ctx);
+	void *ctx;
+	uint32_t k;
+};
+
+static int
+community_cb(const struct Node **nodes, size_t count, void *ctx)
+{
+	struct community_ctx *cc = ctx;
+	return (*cc->cb)(cc->k, nodes, count, cc->ctx);
+}
+
+int
+graph_clique_percolation(const struct Graph *g, const uint32_t *ks, size_t nk, const struct clique_options *opt,
+			 int (*cb)(uint32_t k, const struct Node **nodes, size_t count, void *ctx), void *ctx)
+{
+	struct clique_options o = { 0 };
+	struct percolation pc;
+	struct community_ctx cc = { .cb = cb, .ctx = ctx };
+	void *ctxs[1] = { &pc };
+	int ret;
+
+	if (percolation_init(&pc, g, ks, nk))
+		return -1;
+	if (opt)
+		o = *opt;
+	/* Smaller cliques take no part, and the search can skip them. */
+	o.min_size = pc.ks[0];
+	o.serialize = true;
+	ret = graph_iterate_maximal_cliques_opt(g, &o, percolation_add_clique, ctxs);
+	for (uint32_t j = 0; j < pc.nk && ret == 0; ++j) {
+		cc.k = pc.ks[j];
+		ret = percolation_communities(&pc, cc.k, community_cb, &cc);
+	}
+	percolation_destroy(&pc);
+	return ret;
+}
@@ -0,0 +1,139 @@
+#ifndef PERCOLATION_H_INCLUDED
+#define PERCOLATION_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "graph.h"
+#include "clique.h"
+
+/*
+ * Overlapping communities by k-clique percolation (Palla, Derényi,
+ * Farkas and Vicsek): two k-cliques are adjacent if they share k-1
+ * nodes, and a community is the union of the k-cliques of a connected
+ * class of that relation. Since every k-clique lies in some maximal
+ * clique, and two maximal cliques of at least k nodes contain
+ * adjacent k-cliques exactly when they share at least k-1 nodes, the
+ * communities can be built from the maximal cliques alone.
+ *
+ * The maximal cliques are fed in one at a time, as they are
+ * enumerated (percolation_add_clique() fits the callback of
+ * graph_iterate_maximal_cliques()), are kept as sorted arrays of node
+ * indices, and are united with the earlier cliques they are adjacent
+ * to in one union-find forest per k, so several values of k cost a
+ * single enumeration. There are two ways of finding those:
+ *
+ * Sharing k-1 nodes means sharing a (k-1)-subset, and all the cliques
+ * containing a given subset end up in the same class, so it suffices
+ * to remember one clique per subset. For each k, a hash table maps
+ * every (k-1)-subset of the cliques seen so far to one of them. That
+ * is linear in the number of subsets, C(|C|, k-1) for a clique C,
+ * which is small for small cliques (or small k), but explodes for
+ * large ones.
+ *
+ * So large cliques are counted instead: Each node has a list of the
+ * cliques it is in (and one of only the large cliques it is in), and
+ * for a large clique C, walking the lists of its nodes counts |C ∩ D|
+ * for every earlier clique D sharing a node with it; C and D are then
+ * united for every k up to min(|C|, |D|, |C ∩ D| + 1). A small clique,
+ * which does not find the large ones in the hash tables, walks only
+ * the lists of large cliques.
+ *
+ * A clique is large if, for some k, it has more (k-1)-subsets than
+ * both PERCOLATION_SUBSETS and the total length of the lists it would
+ * walk, i.e. whenever counting is cheaper. In dense regions, where a
+ * node is in thousands of cliques, even cliques of a dozen nodes are
+ * hashed; counting is left to the few huge cliques.
+ */
+
+#define PERCOLATION_SUBSETS 64
+
+struct subset_entry {
+	uint32_t  hash;
+	uint32_t  clique;     /* UINT32_MAX if the slot is empty */
+	uint64_t  subset;     /* the positions of the subset in clique */
+};
+
+/* The (k-1)-subsets seen so far, for one k. */
+struct subset_table {
+	struct subset_entry  *slots;
+	uint32_t             mask;  /* number of slots - 1 */
+	uint32_t             count;
+};
+
+struct percolation {
+	uint32_t           nk;
+	uint32_t           *ks;        /* the values of k, increasing */
+	uint32_t           node_count;
+	const struct Node  **nodes;    /* by index, as far as seen */
+
+	/* Clique c consists of member[start[c]..start[c+1]-1]. */
+	uint32_t           cliques, cliques_cap;
+	uint64_t           *start;
+	uint32_t           **parent;   /* union-find forest for each k */
+	struct subset_table *subsets;  /* for each k */
+	uint32_t           *overlap;   /* scratch, by clique */
+	uint32_t           *touched;
+
+	/*
+	 * Membership e is node member[e] in clique owner[e]; next[e] is
+	 * the node's previous one, and lnext[e] its previous one in a
+	 * large clique (if owner[e] is large).
+	 */
+	uint32_t           members, members_cap;
+	uint32_t           *member, *owner, *next, *lnext;
+	uint32_t           *head;      /* last membership of each node */
+	uint32_t           *lhead;     /* last membership in a large clique */
+	uint32_t           *ncliques;  /* number of cliques of each node */
+	uint32_t           *subset;    /* scratch */
+};
+
+/**
+ * percolation_init - prepare for k-clique percolation
+ *
+ * @ks: The values of k (at least 2), in any order; duplicates are
+ *      ignored.
+ *
+ * Returns: 0 on success, -1 on failure (EINVAL if there is no valid k).
+ */
+int percolation_init(struct percolation *pc, const struct Graph *g, const uint32_t *ks, size_t nk);
+void percolation_destroy(struct percolation *pc);
+
+/*
+ * Add a maximal clique; @ctx is the struct percolation. Cliques with
+ * fewer nodes than the smallest k are ignored. Returns 0 on success,
+ * -1 on failure (EOVERFLOW if a subset table would need more than
+ * 2^32 slots). Not thread safe: with several threads, use it with
+ * serialize set.
+ */
+int percolation_add_clique(const struct Node **nodes, size_t count, void *ctx);
+
+/**
+ * percolation_communities - report the communities for one k
+ *
+ * @k: One of the values given to percolation_init()
+ * @cb: Called for each community, with its nodes in order of index.
+ *      The communities come in the order in which their first clique
+ *      was added. If @cb returns non-zero, stop and return that.
+ *
+ * Returns: 0 on success, -1 on failure (EINVAL if @k is unknown).
+ */
+int percolation_communities(struct percolation *pc, uint32_t k,
+			    int (*cb)(const struct Node **nodes, size_t count, void *ctx), void *ctx);
+
+/**
+ * graph_clique_percolation - k-clique communities in a single pass
+ *
+ * Enumerates the maximal cliques with at least min(@ks) nodes (with
+ * the threads, pivot and budgets of @opt, which may be NULL), and
+ * then calls @cb for every community of every k, in increasing order
+ * of k.
+ *
+ * Returns: 0 on success, the non-zero return value of @cb, or -1 on
+ * failure (ETIMEDOUT if a budget ran out, EOVERFLOW as for
+ * percolation_add_clique()).
+ */
+int graph_clique_percolation(const struct Graph *g, const uint32_t *ks, size_t nk, const struct clique_options *opt,
+			     int (*cb)(uint32_t k, const struct Node **nodes, size_t count, void *ctx), void *ctx);
+
+#endif /* !PERCOLATION_H_INCLUDED */
@@ -0,0 +1,212 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "sortedset.h"
+
+/* Return the smallest index i >= lo such that b[i] >= x, or nb if there is none. */
+static inline size_t
+gallop(const uint32_t *b, size_t nb, size_t lo, uint32_t x)
+{
+	size_t step = 1, hi;
+
+	if (lo >= nb || b[lo] >= x)
+		return lo;
+	/* Invariant: b[lo] < x. Double the step until we overshoot. */
+	while (lo + step < nb && b[lo + step] < x) {
+		lo += step;
+		step *= 2;
+	}
+	hi = lo + step < nb ? lo + step : nb;
+	/* Now b[lo] < x <= b[hi] (taking b[nb] = infinity). */
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (b[mid] < x)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return hi;
+}
+
+size_t
+sortedset_search(const uint32_t *a, size_t n, size_t lo, uint32_t x)
+{
+	return gallop(a, n, lo, x);
+}
+
+static size_t
+gallop_intersect(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out)
+{
+	size_t j = 0, k = 0;
+
+	for (size_t i = 0; i < na; ++i) {
+		j = gallop(b, nb, j, a[i]);
+		if (j == nb)
+			break;
+		if (b[j] == a[i]) {
+			if (out)
+				out[k] = a[i];
+			k++;
+			j++;
+		}
+	}
+	return k;
+}
+
+static size_t
+merge_intersect(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out)
+{
+	size_t i = 0, j = 0, k = 0;
+
+	while (i < na && j < nb) {
+		if (a[i] < b[j]) {
+			i++;
+		} else if (a[i] > b[j]) {
+			j++;
+		} else {
+			if (out)
+				out[k] = a[i];
+			k++;
+			i++;
+			j++;
+		}
+	}
+	return k;
+}
+
+#ifdef __SSE2__
+/*
+ * Compare a block of four elements of A with all four rotations of a
+ * block of B; each element of A matches at most once, so the number
+ * of matches is the number of lanes set. Then advance past whichever
+ * block has the smaller maximum (or both). Elements are compared for
+ * equality only, so signedness does not matter.
+ */
+static size_t
+simd_intersect_count(const uint32_t *a, size_t na, const uint32_t *b, size_t nb)
+{
+	size_t i = 0, j = 0, count = 0;
+
+	while (i + 4 <= na && j + 4 <= nb) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+		__m128i m;
+		uint32_t amax = a[i+3], bmax = b[j+3];
+
+		m = _mm_cmpeq_epi32(va, vb);
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+		count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(m)));
+
+		if (amax <= bmax)
+			i += 4;
+		if (bmax <= amax)
+			j += 4;
+	}
+	return count + merge_intersect(a + i, na - i, b + j, nb - j, NULL);
+}
+
+/*
+ * As above, but storing the matches: the movemask tells which
+ * elements of the block of A are in B, and they are stored in order.
+ * With out == a, the stores never overtake the loads: at most the
+ * elements already compared are overwritten, and an element of A
+ * which is not in the current block of B and is below its maximum
+ * cannot be in any later block of B either.
+ */
+static size_t
+simd_intersect(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out)
+{
+	size_t i = 0, j = 0, k = 0;
+
+	while (i + 4 <= na && j + 4 <= nb) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+		__m128i m;
+		uint32_t amax = a[i+3], bmax = b[j+3];
+		unsigned mask;
+
+		m = _mm_cmpeq_epi32(va, vb);
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+		m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+		mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+		if (mask) {
+			uint32_t blk[4];
+			_mm_storeu_si128((__m128i *)blk, va);
+			while (mask) {
+				out[k++] = blk[__builtin_ctz(mask)];
+				mask &= mask - 1;
+			}
+		}
+
+		if (amax <= bmax)
+			i += 4;
+		if (bmax <= amax)
+			j += 4;
+	}
+	return k + merge_intersect(a + i, na - i, b + j, nb - j, out + k);
+}
+#endif
+
+size_t
+sortedset_intersect_count(const uint32_t *a, size_t na, const uint32_t *b, size_t nb)
+{
+	if (na > nb)
+		return sortedset_intersect_count(b, nb, a, na);
+	if (na == 0)
+		return 0;
+	if (nb / na > SORTEDSET_GALLOP_RATIO)
+		return gallop_intersect(a, na, b, nb, NULL);
+#ifdef __SSE2__
+	return simd_intersect_count(a, na, b, nb);
+#else
+	return merge_intersect(a, na, b, nb, NULL);
+#endif
+}
+
+size_t
+sortedset_intersect(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out)
+{
+	if (na > nb)
+		return sortedset_intersect(b, nb, a, na, out);
+	if (na == 0)
+		return 0;
+	if (nb / na > SORTEDSET_GALLOP_RATIO)
+		return gallop_intersect(a, na, b, nb, out);
+#ifdef __SSE2__
+	/* The block loop writes through out while reading a, which is only safe if out is (at most) a. */
+	if (out == b)
+		return simd_intersect(b, nb, a, na, out);
+	return simd_intersect(a, na, b, nb, out);
+#else
+	return merge_intersect(a, na, b, nb, out);
+#endif
+}
+
+size_t
+sortedset_difference(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out)
+{
+	size_t j = 0, k = 0;
+	bool gallop_b = na && nb / na > SORTEDSET_GALLOP_RATIO;
+
+	for (size_t i = 0; i < na; ++i) {
+		if (gallop_b) {
+			j = gallop(b, nb, j, a[i]);
+		} else {
+			while (j < nb && b[j] < a[i])
+				j++;
+		}
+		if (j < nb && b[j] == a[i])
+			j++;
+		else
+			out[k++] = a[i];
+	}
+	return k;
+}
@@ -0,0 +1,35 @@
+#ifndef SORTEDSET_H_INCLUDED
+#define SORTEDSET_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Operations on sets of 32 bit integers represented as strictly
+ * increasing arrays.
+ *
+ * Intersections pick their strategy based on the sizes of the
+ * operands: When one is much smaller than the other, each of its
+ * elements is looked up in the larger one by galloping (exponential
+ * search followed by binary search, starting from the position of the
+ * previous hit), which costs O(small * log(large/small)). Otherwise,
+ * the two arrays are merged linearly, comparing blocks of four
+ * elements against each other with SSE2 where available.
+ */
+
+/* Use galloping when one set is more than this many times larger than the other. */
+#define SORTEDSET_GALLOP_RATIO 32
+
+/* Return the smallest i >= lo such that a[i] >= x (or n if there is none), galloping from lo. */
+size_t sortedset_search(const uint32_t *a, size_t n, size_t lo, uint32_t x);
+
+/* Return |A ∩ B|. */
+size_t sortedset_intersect_count(const uint32_t *a, size_t na, const uint32_t *b, size_t nb);
+
+/* Store A ∩ B in out, which must have room for min(na, nb) elements (and may be a or b). Returns its size. */
+size_t sortedset_intersect(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out);
+
+/* Store A \ B in out, which must have room for na elements (and may be a). Returns its size. */
+size_t sortedset_difference(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out);
+
+#endif /* !SORTEDSET_H_INCLUDED */
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "spsc.h"
+
+int
+spsc_init(struct spsc *r, size_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1))) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(r, 0, sizeof(*r));
+	r->slots = malloc(capacity * sizeof(*r->slots));
+	if (r->slots == NULL)
+		return -1;
+	r->mask = capacity - 1;
+	return 0;
+}
+
+void
+spsc_destroy(struct spsc *r)
+{
+	free(r->slots);
+	r->slots = NULL;
+}
+
+static void
+spsc_wait(long *backoff)
+{
+	*backoff = *backoff ? (*backoff < 1000000 ? 2 * *backoff : *backoff) : 10000;
+	nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = *backoff }, NULL);
+}
+
+void
+spsc_write(struct spsc *r, const uintptr_t *v, size_t n)
+{
+	size_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+	size_t cap = r->mask + 1;
+	long backoff = 0;
+
+	while (n) {
+		size_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		size_t room = cap - (tail - head), chunk, first;
+
+		if (room == 0) {
+			spsc_wait(&backoff);
+			continue;
+		}
+		backoff = 0;
+		chunk = n < room ? n : room;
+		/* The free slots may wrap around the end of the array. */
+		first = cap - (tail & r->mask);
+		if (first > chunk)
+			first = chunk;
+		memcpy(r->slots + (tail & r->mask), v, first * sizeof(*v));
+		memcpy(r->slots, v + first, (chunk - first) * sizeof(*v));
+		tail += chunk;
+		v += chunk;
+		n -= chunk;
+		__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+	}
+}
+
+void
+spsc_close(struct spsc *r)
+{
+	__atomic_store_n(&r->closed, true, __ATOMIC_RELEASE);
+}
+
+size_t
+spsc_read(struct spsc *r, uintptr_t *v, size_t max)
+{
+	size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	size_t cap = r->mask + 1;
+	long backoff = 0;
+
+	while (1) {
+		/* Load closed first: if it was set, tail is final. */
+		bool closed = __atomic_load_n(&r->closed, __ATOMIC_ACQUIRE);
+		size_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+		size_t avail = tail - head, chunk, first;
+
+		if (avail == 0) {
+			if (closed)
+				return 0;
+			spsc_wait(&backoff);
+			continue;
+		}
+		chunk = avail < max ? avail : max;
+		first = cap - (head & r->mask);
+		if (first > chunk)
+			first = chunk;
+		memcpy(v, r->slots + (head & r->mask), first * sizeof(*v));
+		memcpy(v + first, r->slots, (chunk - first) * sizeof(*v));
+		__atomic_store_n(&r->head, head + chunk, __ATOMIC_RELEASE);
+		return chunk;
+	}
+}
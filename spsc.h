@@ -0,0 +1,55 @@
+#ifndef SPSC_H_INCLUDED
+#define SPSC_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A single-producer, single-consumer ring buffer of machine words,
+ * for handing a stream of data from one thread to another without
+ * locks. The producer only ever writes tail, the consumer only ever
+ * writes head; each publishes its progress with a release store and
+ * reads the other's with an acquire load, so the words between them
+ * are visible to the consumer once tail has moved past them.
+ *
+ * The ring is a stream, not a queue of messages: spsc_write() blocks
+ * while the ring is full and may publish a long array in several
+ * pieces, and spsc_read() returns whatever is available. Record
+ * boundaries are up to the users; a length word followed by the
+ * payload works for records of any length, even longer than the ring.
+ *
+ * "Blocking" is by sleeping with exponential backoff (10us up to
+ * 1ms), which costs nothing while data flows and needs no wakeups.
+ *
+ * There may be several producer threads, as long as they are
+ * serialized by some lock: the lock then orders their accesses to
+ * tail.
+ */
+
+struct spsc {
+	uintptr_t  *slots;
+	size_t     mask;      /* capacity - 1 */
+	size_t     head __attribute__((aligned(64)));  /* next slot to read */
+	size_t     tail __attribute__((aligned(64)));  /* next slot to write */
+	bool       closed;
+};
+
+/* @capacity must be a power of two. Returns 0 on success, -1 on failure. */
+int spsc_init(struct spsc *r, size_t capacity);
+void spsc_destroy(struct spsc *r);
+
+/* Append @n words, waiting for room as necessary. */
+void spsc_write(struct spsc *r, const uintptr_t *v, size_t n);
+
+/* Tell the consumer that no more data will be written. */
+void spsc_close(struct spsc *r);
+
+/*
+ * Read up to @max words into @v, waiting until at least one is
+ * available. Returns the number of words read, or 0 if the ring has
+ * been closed and drained.
+ */
+size_t spsc_read(struct spsc *r, uintptr_t *v, size_t max);
+
+#endif /* !SPSC_H_INCLUDED */
@@ -0,0 +1,303 @@
+#!/bin/bash
+
+test_description='Test the graph tools
+
+Small known-answer cases, and cross-checks of different ways of
+computing the same thing against each other.'
+
+. sharness/sharness.sh
+
+# The tools are built in the top directory.
+PATH="${SHARNESS_TEST_DIRECTORY}/..:${PATH}"
+
+# A random graph with a fixed seed: 80 nodes, dense enough for
+# cliques of up to 5 nodes, plus a few isolated nodes.
+awk 'BEGIN {
+	srand(42);
+	for (i = 0; i < 80; ++i)
+		for (j = i + 1; j < 80; ++j)
+			if (rand() < 0.25)
+				print "n" i "\tn" j;
+	for (i = 80; i < 83; ++i)
+		print "n" i;
+}' > graph.txt
+
+# Convert an edge list to the binary format (see graph.h), with a
+# dictionary, numbering the nodes in order of appearance.
+to_binary () {
+    perl -e '
+	my (%id, @names, @pairs);
+	sub id { my $s = shift; unless (exists $id{$s}) { $id{$s} = @names; push @names, $s; } $id{$s} }
+	while (<STDIN>) {
+	    my @f = split;
+	    next unless @f;
+	    push @pairs, id($f[0]), @f > 1 ? id($f[1]) : 0xffffffff;
+	}
+	binmode STDOUT;
+	print "\x89RVG", pack("CCCCQ", 1, 4, 1, 0, scalar @names);
+	print map { "$_\0" } @names;
+	print pack("L*", @pairs);
+    '
+}
+
+# The cliques of "id<TAB>node" output as one sorted line of nodes
+# each, sorted; a clique printed twice (as after --resume) is merged.
+canon () {
+    sort -u | perl -ane '
+	push @{$c{$F[0]}}, $F[1];
+	END { print join(" ", sort @$_), "\n" for values %c }
+    ' | sort
+}
+
+# k-clique communities by brute force from canon output: cliques of
+# at least k nodes sharing k-1 nodes are joined, and a community is
+# the union of a class. Prints "k<TAB>nodes" lines, sorted.
+cpm_reference () {
+    perl -e '
+	my @ks = split /,/, shift;
+	my @c = map { [split] } <STDIN>;
+	for my $k (@ks) {
+	    my @big = grep { @$_ >= $k } @c;
+	    my @p = (0..$#big);
+	    sub find { my ($p, $i) = @_; $i = $p->[$i] while $p->[$i] != $i; $i }
+	    for my $i (0..$#big) {
+		my %in = map { $_ => 1 } @{$big[$i]};
+		for my $j (0..$i-1) {
+		    my $shared = grep { $in{$_} } @{$big[$j]};
+		    $p[find(\@p, $i)] = find(\@p, $j) if $shared >= $k - 1;
+		}
+	    }
+	    my %com;
+	    for my $i (0..$#big) {
+		$com{find(\@p, $i)}{$_} = 1 for @{$big[$i]};
+	    }
+	    print "$k\t", join(" ", sort keys %{$com{$_}}), "\n" for keys %com;
+	}
+    ' "$1" | sort
+}
+
+test_expect_success "binary input" \
+    "to_binary < graph.txt > graph.bin &&
+     graphcomponents < graph.txt > comp.txt &&
+     graphcomponents < graph.bin > comp.bin &&
+     test_cmp comp.txt comp.bin &&
+     maximal_cliques < graph.txt > cliques.txt &&
+     maximal_cliques < graph.bin > cliques.bin &&
+     test_cmp cliques.txt cliques.bin"
+
+test_expect_success "truncated binary input" \
+    "head -c 20 graph.bin > short.bin &&
+     test_must_fail graphcomponents < short.bin"
+
+test_expect_success "parallel loading" \
+    "split -l 300 graph.txt part. &&
+     graphcomponents < graph.txt | sort > comp.serial &&
+     graphcomponents -j 4 part.* | sort > comp.parallel &&
+     test_cmp comp.serial comp.parallel"
+
+test_expect_success "threads" \
+    "maximal_cliques -j 1 < graph.txt | canon > j1 &&
+     maximal_cliques -j 4 < graph.txt | canon > j4 &&
+     test_cmp j1 j4"
+
+test_expect_success "--min-size" \
+    "maximal_cliques -x < graph.txt | canon | awk 'NF >= 4' > filtered &&
+     maximal_cliques -k 4 < graph.txt | canon > k4 &&
+     test_cmp filtered k4"
+
+test_expect_success "--checkpoint and --resume" \
+    "maximal_cliques < graph.txt | canon > all &&
+     test_expect_code 3 maximal_cliques --max-cliques=50 --checkpoint=ck < graph.txt > out &&
+     maximal_cliques --resume=ck < graph.txt >> out &&
+     canon < out > resumed &&
+     test_cmp all resumed"
+
+test_expect_success "-c does not combine with --resume" \
+    "test_must_fail maximal_cliques -c --resume=ck < graph.txt"
+
+# Query the endpoints of the first edge, which are certainly adjacent.
+read u v < graph.txt
+
+test_expect_success "--query" \
+    "maximal_cliques < graph.txt | canon > all &&
+     grep -E '(^| )$u( |\$)' all > expected &&
+     maximal_cliques -q $u < graph.txt | canon > actual &&
+     test_cmp expected actual &&
+     grep -E '(^| )$u( |\$)' all | grep -E '(^| )$v( |\$)' > expected &&
+     maximal_cliques -q $u -q $v -q $u < graph.txt | canon > actual &&
+     test_cmp expected actual"
+
+test_expect_success "--query of nodes which are not a clique" \
+    "maximal_cliques -q $u -q n80 < graph.txt > actual &&
+     ! test -s actual"
+
+test_expect_success "--query of an unknown node" \
+    "test_must_fail maximal_cliques -q nosuchnode < graph.txt"
+
+# The random graph, plus a clique of 70 nodes (more than the 63 which
+# are ever hashed) with a fringe of triangles attached to it.
+cat graph.txt > bigclique.txt
+awk 'BEGIN {
+	for (i = 0; i < 70; ++i)
+		for (j = i + 1; j < 70; ++j)
+			print "b" i "\tb" j;
+	for (i = 0; i < 10; ++i)
+		print "b" i "\tn" i "\nb" i+1 "\tn" i;
+}' >> bigclique.txt
+
+communities () {
+    perl -ane 'push @{$c{"$F[0]\t$F[1]"}}, $F[2];
+	END { print((split /\t/)[0], "\t", join(" ", sort @{$c{$_}}), "\n") for keys %c }' | sort
+}
+
+test_expect_success "--communities" \
+    "maximal_cliques < graph.txt | canon | cpm_reference 2,3,4,5 > expected &&
+     maximal_cliques --communities=2,3,4,5 < graph.txt | communities > actual &&
+     test_cmp expected actual &&
+     maximal_cliques --communities=2,3,4,5 -j 2 < graph.txt | communities > actual &&
+     test_cmp expected actual"
+
+test_expect_success "--communities with a large clique" \
+    "maximal_cliques < bigclique.txt | canon | cpm_reference 2,3,4,5 > expected &&
+     maximal_cliques --communities=2,3,4,5 < bigclique.txt | communities > actual &&
+     test_cmp expected actual &&
+     maximal_cliques --communities=2,3,4,5 -j 2 < bigclique.txt | communities > actual &&
+     test_cmp expected actual"
+
+test_expect_success "--maximum" \
+    "maximal_cliques < graph.txt | canon > all &&
+     awk 'NF > max { max = NF } END { print max }' all > expected &&
+     maximal_cliques --maximum < graph.txt > maximum &&
+     wc -l < maximum | tr -d ' ' > actual &&
+     test_cmp expected actual &&
+     canon < maximum > clique &&
+     grep -qxF -f clique all"
+
+test_expect_success "--count" \
+    "maximal_cliques < graph.txt | canon | awk '{ print NF }' | sort -n | uniq -c |
+	 awk '{ print \$2 \"\t\" \$1 }' > expected &&
+     maximal_cliques -c < graph.txt > actual &&
+     test_cmp expected actual &&
+     maximal_cliques -c -j 4 < graph.txt > actual &&
+     test_cmp expected actual"
+
+# Decode the binary output of maximal_cliques (see its --help) to text.
+from_binary () {
+    perl -e '
+	binmode STDIN;
+	local $/;
+	my $data = <STDIN>;
+	my ($magic, $version, $width, $pad, $n) = unpack("a4 C C n Q", $data);
+	die "bad header\n" unless $magic eq "\x89RVC" && $version == 1 && $width == 4 && $pad == 0;
+	my $pos = 16;
+	my @names;
+	for (1..$n) {
+	    my $end = index($data, "\0", $pos);
+	    push @names, substr($data, $pos, $end - $pos);
+	    $pos = $end + 1;
+	}
+	while ($pos < length $data) {
+	    my ($id, $count) = unpack("Q L", substr($data, $pos, 12));
+	    my @nodes = unpack("L$count", substr($data, $pos + 12, 4 * $count));
+	    print "$id\t$names[$_]\n" for @nodes;
+	    $pos += 12 + 4 * $count;
+	}
+    '
+}
+
+test_expect_success "--binary" \
+    "maximal_cliques < graph.txt > text &&
+     maximal_cliques -b < graph.txt | from_binary > decoded &&
+     test_cmp text decoded"
+
+# Loops, edges given in both directions and isolated nodes must not
+# change the cliques of the underlying simple graph.
+cat > messy.txt <<EOF
+a b
+b a
+a c
+c b
+c c
+b d
+d c
+e
+d d
+f g
+g f
+h h
+EOF
+
+cat > messy.expected <<EOF
+a b c
+b c d
+e
+f g
+h
+EOF
+
+test_expect_success "loops, reversed and isolated edges" \
+    "maximal_cliques < messy.txt | canon > actual &&
+     test_cmp messy.expected actual &&
+     maximal_cliques -j 2 < messy.txt | canon > actual &&
+     test_cmp messy.expected actual"
+
+test_expect_success "graphdistances --order" \
+    "graphdistances -s n0 -s n5 < graph.txt | sort > expected &&
+     for o in degree bfs component
+     do
+	 graphdistances -o \$o -s n0 -s n5 < graph.txt | sort > actual &&
+	 test_cmp expected actual || return 1
+     done"
+
+# A path p0 - ... - p5, given in both directions, and an isolated q.
+cat > path.txt <<EOF
+p0 p1
+p2 p1
+p2 p3
+p3 p4
+p5 p4
+q
+EOF
+
+test_expect_success "graphdistances on a path" \
+    "printf 'p0\t0\np1\t1\np2\t2\np3\t3\np4\t4\np5\t5\n' > expected &&
+     graphdistances -s p0 < path.txt | sort > actual &&
+     test_cmp expected actual &&
+     printf 'p0\t2\np1\t1\np2\t0\np3\t1\np4\t1\np5\t0\n' > expected &&
+     graphdistances -s p2 -s p5 < path.txt | sort > actual &&
+     test_cmp expected actual &&
+     printf '1\t6\t5\n2\t1\t0\n' > expected &&
+     graphdistances -d < path.txt | cut -f 1-3 > actual &&
+     test_cmp expected actual"
+
+# A K4 on a, b, c, d, with a tail d - e - f.
+cat > k4.txt <<EOF
+a b
+b c
+a c
+a d
+b d
+c d
+d e
+e f
+EOF
+
+test_expect_success "graphcomponents --cores" \
+    "printf '1\ta\t3\n1\tb\t3\n1\tc\t3\n1\td\t3\n1\te\t1\n1\tf\t1\n' > expected &&
+     graphcomponents -k < k4.txt > actual &&
+     test_cmp expected actual &&
+     printf '0\t0\t6\n1\t2\t6\n2\t0\t4\n3\t4\t4\n' > expected &&
+     graphcomponents -K < k4.txt > actual &&
+     test_cmp expected actual"
+
+test_expect_success "graphtriangles" \
+    "printf '6\t8\t4\t16\t0.750000\t0.583333\n' > expected &&
+     graphtriangles -s < k4.txt > actual &&
+     test_cmp expected actual &&
+     graphtriangles -j 2 < k4.txt > actual &&
+     test_cmp expected actual &&
+     printf '1\ta\t3\t3\t1.000000\n1\tb\t3\t3\t1.000000\n1\tc\t3\t3\t1.000000\n1\td\t4\t3\t0.500000\n1\te\t2\t0\t0.000000\n1\tf\t1\t0\t0.000000\n' > expected &&
+     graphtriangles -n < k4.txt > actual &&
+     test_cmp expected actual"
+
+test_done
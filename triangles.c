@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "frozen.h"
+#include "sortedset.h"
+#include "triangles.h"
+
+/*
+ * The oriented graph is built as a second CSR structure. Filtering
+ * the (sorted) symmetric adjacency lists preserves their order, so
+ * the out-neighbour lists are sorted by node number and can be
+ * intersected directly.
+ *
+ * Threads claim chunks of nodes from a shared counter. With per-node
+ * counts, the counters of v and w belong to other nodes' chunks, so
+ * they are updated atomically when running multi-threaded.
+ */
+
+#define TRIANGLE_CHUNK 256
+
+struct tricount {
+	const struct FrozenGraph *fg;
+	uint64_t   *ooff;
+	uint32_t   *oadj;
+	uint32_t   maxout;
+	uint32_t   next;      /* next chunk to claim */
+	uint64_t   *per_node;
+	bool       atomic;
+	uint64_t   triangles;
+	int        err;
+};
+
+static inline bool
+oriented_before(const struct FrozenGraph *fg, uint32_t u, uint32_t v)
+{
+	uint64_t du = frozen_degree(fg, u), dv = frozen_degree(fg, v);
+	return du < dv || (du == dv && u < v);
+}
+
+static inline void
+add_count(struct tricount *tc, uint32_t v, uint64_t c)
+{
+	if (tc->atomic)
+		__atomic_fetch_add(&tc->per_node[v], c, __ATOMIC_RELAXED);
+	else
+		tc->per_node[v] += c;
+}
+
+static void *
+tricount_worker(void *arg)
+{
+	struct tricount *tc = arg;
+	uint32_t n = tc->fg->node_count;
+	uint32_t *buf = NULL;
+	uint64_t total = 0;
+
+	if (tc->per_node) {
+		buf = malloc((tc->maxout ? tc->maxout : 1) * sizeof(*buf));
+		if (buf == NULL) {
+			__atomic_store_n(&tc->err, ENOMEM, __ATOMIC_RELAXED);
+			return NULL;
+		}
+	}
+
+	while (1) {
+		uint64_t lo = (uint64_t)__atomic_fetch_add(&tc->next, 1, __ATOMIC_RELAXED) * TRIANGLE_CHUNK;
+		uint64_t hi = lo + TRIANGLE_CHUNK < n ? lo + TRIANGLE_CHUNK : n;
+
+		if (lo >= n)
+			break;
+		for (uint32_t u = lo; u < hi; ++u) {
+			const uint32_t *nu = tc->oadj + tc->ooff[u];
+			size_t du = tc->ooff[u+1] - tc->ooff[u];
+			uint64_t tu = 0;
+
+			for (size_t k = 0; k < du; ++k) {
+				uint32_t v = nu[k];
+				const uint32_t *nv = tc->oadj + tc->ooff[v];
+				size_t dv = tc->ooff[v+1] - tc->ooff[v];
+				size_t c;
+
+				if (!tc->per_node) {
+					tu += sortedset_intersect_count(nu, du, nv, dv);
+					continue;
+				}
+				c = sortedset_intersect(nu, du, nv, dv, buf);
+				tu += c;
+				if (c) {
+					add_count(tc, v, c);
+					for (size_t l = 0; l < c; ++l)
+						add_count(tc, buf[l], 1);
+				}
+			}
+			if (tc->per_node && tu)
+				add_count(tc, u, tu);
+			total += tu;
+		}
+	}
+	free(buf);
+	__atomic_fetch_add(&tc->triangles, total, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+int
+frozen_count_triangles(const struct FrozenGraph *fg, struct TriangleStats *ts, unsigned nthreads)
+{
+	struct tricount tc;
+	uint32_t n = fg->node_count;
+	pthread_t *tids = NULL;
+	unsigned started = 0;
+
+	if (!(fg->flags & FROZEN_SYMMETRIC)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&tc, 0, sizeof(tc));
+	tc.fg = fg;
+	tc.per_node = ts->per_node;
+	tc.ooff = malloc(((size_t)n + 1) * sizeof(*tc.ooff));
+	/* Each edge is stored twice in fg, once in the oriented graph. */
+	tc.oadj = malloc((fg->adj_count / 2 ? fg->adj_count / 2 : 1) * sizeof(*tc.oadj));
+	if (tc.ooff == NULL || tc.oadj == NULL)
+		goto nomem;
+
+	ts->wedges = 0;
+	tc.ooff[0] = 0;
+	for (uint32_t u = 0; u < n; ++u) {
+		uint64_t d = frozen_degree(fg, u), w = tc.ooff[u];
+
+		ts->wedges += d ? d * (d - 1) / 2 : 0;
+		for (uint64_t k = fg->offset[u]; k < fg->offset[u+1]; ++k) {
+			if (oriented_before(fg, u, fg->adj[k]))
+				tc.oadj[w++] = fg->adj[k];
+		}
+		tc.ooff[u+1] = w;
+		if (w - tc.ooff[u] > tc.maxout)
+			tc.maxout = w - tc.ooff[u];
+	}
+	if (tc.per_node)
+		memset(tc.per_node, 0, n * sizeof(*tc.per_node));
+
+	if (nthreads > 1) {
+		tids = calloc(nthreads, sizeof(*tids));
+		if (tids == NULL)
+			goto nomem;
+		tc.atomic = true;
+		for (started = 0; started < nthreads; ++started) {
+			if (pthread_create(&tids[started], NULL, tricount_worker, &tc))
+				break;
+		}
+	}
+	if (started == 0)
+		tricount_worker(&tc);
+	for (unsigned t = 0; t < started; ++t)
+		pthread_join(tids[t], NULL);
+
+	free(tids);
+	free(tc.ooff);
+	free(tc.oadj);
+	if (tc.err) {
+		errno = tc.err;
+		return -1;
+	}
+	ts->triangles = tc.triangles;
+	return 0;
+
+nomem:
+	free(tc.ooff);
+	free(tc.oadj);
+	errno = ENOMEM;
+	return -1;
+}
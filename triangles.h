@@ -0,0 +1,53 @@
+#ifndef TRIANGLES_H_INCLUDED
+#define TRIANGLES_H_INCLUDED
+
+#include <stdint.h>
+
+#include "frozen.h"
+
+/*
+ * Triangle counting over a frozen graph created with
+ * FROZEN_SYMMETRIC (i.e., the simple undirected graph underlying a
+ * struct Graph).
+ *
+ * Each edge is oriented from the endpoint of lower degree to the one
+ * of higher degree (ties broken by node number). Every triangle then
+ * has a unique lowest node u and middle node v, and is found exactly
+ * once as an element of N+(u) ∩ N+(v), where N+ is the set of
+ * out-neighbours in the oriented graph. Orientation bounds every
+ * out-degree by O(sqrt(m)), so the total work is O(m^1.5) even on
+ * graphs with huge hubs.
+ */
+
+struct TriangleStats {
+	uint64_t  triangles;
+	uint64_t  wedges;     /* paths of length two, sum of d(d-1)/2 */
+	uint64_t  *per_node;  /* if non-NULL, receives the number of triangles containing each node */
+};
+
+/**
+ * frozen_count_triangles - count the triangles of a frozen graph
+ *
+ * @ts: ts->per_node must be NULL or point to fg->node_count entries
+ * @nthreads: The number of threads to use
+ *
+ * Returns: 0 on success, -1 on failure (EINVAL if @fg is not symmetric).
+ */
+int frozen_count_triangles(const struct FrozenGraph *fg, struct TriangleStats *ts, unsigned nthreads);
+
+/* Global clustering coefficient: the fraction of wedges which are closed. */
+static inline double
+triangles_transitivity(const struct TriangleStats *ts)
+{
+	return ts->wedges ? 3.0 * ts->triangles / ts->wedges : 0.0;
+}
+
+/* Local clustering coefficient of node v; requires ts->per_node. */
+static inline double
+triangles_clustering(const struct FrozenGraph *fg, const struct TriangleStats *ts, uint32_t v)
+{
+	uint64_t d = frozen_degree(fg, v);
+	return d > 1 ? 2.0 * ts->per_node[v] / (d * (d - 1)) : 0.0;
+}
+
+#endif /* !TRIANGLES_H_INCLUDED */